@@ -22,6 +22,7 @@
 #include "prototypes.h"
 
 #include <ctype.h>
+#include <stdint.h>
 #include <string.h>
 #ifdef ENABLE_UTF8
 #include <wchar.h>
@@ -284,12 +285,64 @@ int char_length(const char *pointer)
 	return 1;
 }
 
+#define EIGHT_TIMES(byte)  ((uint64_t)(byte) * 0x0101010101010101ULL)
+
+/* Return how many bytes at the start of the given text (looking at no more
+ * than most bytes) are ASCII -- or, when printable is TRUE, are printable
+ * ASCII: from space to tilde.  Check eight bytes at a time where possible. */
+size_t ascii_run(const char *text, size_t most, bool printable)
+{
+	size_t index = 0, length = 0;
+
+	/* Examine the text in blocks, so as to not look far beyond the run. */
+	while (length < most) {
+		size_t block = (most - length < 64) ? most - length : 64;
+		size_t found = strnlen(text + length, block);
+
+		length += found;
+
+		while (index + 8 <= length) {
+			uint64_t chunk;
+
+			memcpy(&chunk, text + index, 8);
+
+			/* Stop at a chunk with a byte above 0x7F, or (when printable) with
+			 * a byte below 0x20 or equal to 0x7F.  When all high bits are clear,
+			 * a subtraction sets a high bit only when some byte is too small. */
+			if ((chunk & EIGHT_TIMES(0x80)) || (printable &&
+						(((chunk - EIGHT_TIMES(0x20)) & EIGHT_TIMES(0x80)) ||
+						(((chunk ^ EIGHT_TIMES(0x7F)) - EIGHT_TIMES(0x01)) & EIGHT_TIMES(0x80)))))
+				break;
+
+			index += 8;
+		}
+
+		if (found < block || index < length)
+			break;
+	}
+
+	while (index < length && (signed char)text[index] >= 0 &&
+				(!printable || (text[index] >= ' ' && text[index] != DEL_CODE)))
+		index++;
+
+	return index;
+}
+
 /* Return the number of (multibyte) characters in the given string. */
 size_t mbstrlen(const char *pointer)
 {
 	size_t count = 0;
 
 	while (*pointer) {
+		/* Count a stretch of ASCII in one go, as each byte is a character. */
+		if ((signed char)*pointer > 0) {
+			size_t run = ascii_run(pointer, HIGHEST_POSITIVE, FALSE);
+
+			pointer += run;
+			count += run;
+			continue;
+		}
+
 		pointer += char_length(pointer);
 		count++;
 	}
@@ -458,14 +511,34 @@ int mbstrncasecmp(const char *s1, const char *s2, size_t n)
 	return strncasecmp(s1, s2, n);
 }
 
+#ifdef ENABLE_UTF8
+/* Return TRUE when a case-insensitive match of a needle that begins with the
+ * given ASCII character could begin with the given byte: when the byte is
+ * that character in either case, or when it starts a multibyte character
+ * (as some of these fold to ASCII letters). */
+static inline bool could_start(unsigned char byte, unsigned char lower, unsigned char upper)
+{
+	return (byte == lower || byte == upper || byte > 0xC1);
+}
+#endif
+
 /* This function is equivalent to strcasestr() for multibyte strings. */
 char *mbstrcasestr(const char *haystack, const char *needle)
 {
 #ifdef ENABLE_UTF8
 	if (using_utf8) {
 		size_t needle_len = mbstrlen(needle);
+		unsigned char lower = tolower((unsigned char)*needle);
+		unsigned char upper = toupper((unsigned char)*needle);
+		bool filter = ((signed char)*needle > 0);
 
 		while (*haystack) {
+			/* Quickly skip the bytes with which no match can begin. */
+			if (filter && !could_start(*haystack, lower, upper)) {
+				haystack++;
+				continue;
+			}
+
 			if (mbstrncasecmp(haystack, needle, needle_len) == 0)
 				return (char *)haystack;
 
@@ -491,7 +564,7 @@ char *revstrstr(const char *haystack, const char *needle,
 		pointer -= (needle_len - tail_len);
 
 	while (pointer >= haystack) {
-		if (strncmp(pointer, needle, needle_len) == 0)
+		if (*pointer == *needle && strncmp(pointer, needle, needle_len) == 0)
 			return (char *)pointer;
 		pointer--;
 	}
@@ -506,12 +579,14 @@ char *revstrcasestr(const char *haystack, const char *needle,
 {
 	size_t needle_len = strlen(needle);
 	size_t tail_len = strlen(pointer);
+	int lower = tolower((unsigned char)*needle);
 
 	if (tail_len < needle_len)
 		pointer -= (needle_len - tail_len);
 
 	while (pointer >= haystack) {
-		if (strncasecmp(pointer, needle, needle_len) == 0)
+		if (tolower((unsigned char)*pointer) == lower &&
+						strncasecmp(pointer, needle, needle_len) == 0)
 			return (char *)pointer;
 		pointer--;
 	}
@@ -532,17 +607,27 @@ char *mbrevstrcasestr(const char *haystack, const char *needle,
 		if (tail_len < needle_len)
 			pointer -= (needle_len - tail_len);
 
+		unsigned char lower = tolower((unsigned char)*needle);
+		unsigned char upper = toupper((unsigned char)*needle);
+		bool filter = ((signed char)*needle > 0);
+
 		if (pointer < haystack)
 			return NULL;
 
 		while (TRUE) {
-			if (mbstrncasecmp(pointer, needle, needle_len) == 0)
+			if ((!filter || could_start(*pointer, lower, upper)) &&
+							mbstrncasecmp(pointer, needle, needle_len) == 0)
 				return (char *)pointer;
 
 			if (pointer == haystack)
 				return NULL;
 
-			pointer = haystack + step_left(haystack, pointer - haystack);
+			/* When filtering, simply step back bytewise, because bytes in the
+			 * middle of a multibyte character do not pass the filter. */
+			if (filter)
+				pointer--;
+			else
+				pointer = haystack + step_left(haystack, pointer - haystack);
 		}
 	}
 #endif
@@ -28,6 +28,15 @@
 #include <magic.h>
 #endif
 #include <string.h>
+#ifdef USE_POSIX_THREADS
+#include <pthread.h>
+#include <unistd.h>
+#endif
+
+//#define TIMEPRECALC  123
+#ifdef TIMEPRECALC
+#include <time.h>
+#endif
 
 static bool defaults_allowed = FALSE;
 		/* Whether ncurses accepts -1 to mean "default color". */
@@ -230,8 +239,86 @@ void find_and_prime_applicable_syntax(void)
 	openfile->syntax = sntx;
 }
 
+/* Determine how the given multiline rule applies to the given line, where
+ * inside says whether the line is preceded by an unterminated start match. */
+short multiline_state(const colortype *ink, const linestruct *line, bool inside)
+{
+	regmatch_t startmatch, endmatch;
+	short state = NOTHING;
+	int index = 0;
+
+	/* When inside a region, there must be an end match to get out of it. */
+	if (inside) {
+		if (regexec(ink->end, line->data, 1, &endmatch, 0) != 0)
+			return WHOLELINE;
+
+		state = ENDSHERE;
+		index = endmatch.rm_eo;
+	}
+
+	/* Look for start matches, and for an end match after each one. */
+	while (regexec(ink->start, line->data + index, 1, &startmatch,
+									(index == 0) ? 0 : REG_NOTBOL) == 0) {
+		/* Begin looking for an end match after the start match. */
+		index += startmatch.rm_eo;
+
+		/* Without an end match on this same line, the region stays open. */
+		if (regexec(ink->end, line->data + index, 1, &endmatch,
+									(index == 0) ? 0 : REG_NOTBOL) != 0)
+			return STARTSHERE;
+
+		state = JUSTONTHIS;
+		index += endmatch.rm_eo;
+
+		/* If the total match has zero length, force an advance. */
+		if (startmatch.rm_eo - startmatch.rm_so + endmatch.rm_eo == 0) {
+			/* When at end-of-line, there is no other start. */
+			if (line->data[index] == '\0')
+				break;
+			index = step_right(line->data, index);
+		}
+	}
+
+	return state;
+}
+
+/* Compute the multiline info of the given line from its text and from the
+ * info of the line before it.  Return TRUE when the info changed. */
+bool recompute_multidata(linestruct *line)
+{
+	const linestruct *priorline = line->prev;
+	bool changed = FALSE;
+
+	if (line->multidata == NULL) {
+		line->multidata = nmalloc(openfile->syntax->multiscore * sizeof(short));
+		changed = TRUE;
+	}
+
+	for (const colortype *ink = openfile->syntax->color; ink != NULL; ink = ink->next) {
+		bool inside;
+		short state;
+
+		/* If this is not a multi-line regex, skip it. */
+		if (ink->end == NULL)
+			continue;
+
+		inside = (priorline && priorline->multidata &&
+								(priorline->multidata[ink->id] == STARTSHERE ||
+								priorline->multidata[ink->id] == WHOLELINE));
+		state = multiline_state(ink, line, inside);
+
+		if (line->multidata[ink->id] != state) {
+			line->multidata[ink->id] = state;
+			changed = TRUE;
+		}
+	}
+
+	return changed;
+}
+
 /* Determine whether the matches of multiline regexes are still the same,
- * and if not, schedule a screen refresh, so things will be repainted. */
+ * and if not, recompute the info of this and following lines (for as far
+ * as the info changes) and schedule a screen refresh. */
 void check_the_multis(linestruct *line)
 {
 	const colortype *ink;
@@ -277,99 +364,337 @@ void check_the_multis(linestruct *line)
 				continue;
 		}
 
-		/* There is a mismatch, so something changed: repaint. */
+		/* There is a mismatch, so something changed: recompute the info
+		 * from here onward until it stops changing, and repaint. */
+		while (line && line->multidata && recompute_multidata(line))
+			line = line->next;
+
+#ifndef NANO_TINY
+		forget_the_rows();
+#endif
 		refresh_needed = TRUE;
-		perturbed = TRUE;
 		return;
 	}
 }
 
-/* Precalculate the multi-line start and end regex info so we can
- * speed up rendering (with any hope at all...). */
-void precalc_multicolorinfo(void)
+/* Compute the multiline info for the given line and for any lines before it
+ * that lack this info, so that the line can be painted correctly.  This way
+ * the info for a freshly opened file gets computed just for what is shown. */
+void precalc_up_to(linestruct *lastline)
 {
-	const colortype *ink;
-	regmatch_t startmatch, endmatch;
-	linestruct *line, *tailline;
+	linestruct *line = lastline;
 
-	if (!openfile->syntax || openfile->syntax->multiscore == 0 || ISSET(NO_SYNTAX))
-		return;
+	while (line->prev && line->prev->multidata == NULL)
+		line = line->prev;
 
-//#define TIMEPRECALC  123
+	for (; line != lastline->next; line = line->next)
+		recompute_multidata(line);
+}
+
+#ifdef USE_POSIX_THREADS
+/* The most threads that will share the precalculation of multiline info. */
+#define MAX_WORKERS  32
+/* The number of chunks per thread, to even out the differences between rules. */
+#define CHUNKS_PER_WORKER  4
+/* The least number of lines that makes it worth starting another thread. */
+#define LINES_PER_WORKER  20000
+
+typedef struct workerstruct {
+	pthread_t thread;
+		/* The identifier of this thread. */
+	const colortype **rules;
+		/* The multiline rules, with regexes that only this thread uses. */
 #ifdef TIMEPRECALC
-#include <time.h>
-	clock_t start = clock();
+	double busy;
+		/* The processor time that this thread spent, in milliseconds. */
+	int tasks;
+		/* The number of rule-and-chunk combinations this thread did. */
 #endif
+} workerstruct;
+
+static linestruct *boundary[MAX_WORKERS * CHUNKS_PER_WORKER + 1];
+		/* The first line of each chunk, followed by NULL. */
+static int chunkcount = 0;
+		/* The number of chunks into which the buffer has been divided. */
+static int rulecount = 0;
+		/* The number of multiline rules in the current syntax. */
+static int nexttask = 0;
+		/* The next rule-and-chunk combination that is up for grabs. */
+static pthread_mutex_t tasklock = PTHREAD_MUTEX_INITIALIZER;
+		/* The lock that guards the handing out of tasks. */
+
+/* Compile the given regex anew, or, if that fails, share the original. */
+static regex_t *private_copy(regex_t *original, const char *text, int flags)
+{
+	regex_t *copy = nmalloc(sizeof(regex_t));
 
-	/* For each line, allocate cache space for the multiline-regex info. */
-	for (line = openfile->filetop; line != NULL; line = line->next)
-		if (!line->multidata)
-			line->multidata = nmalloc(openfile->syntax->multiscore * sizeof(short));
+	if (regcomp(copy, text, flags) == 0)
+		return copy;
 
-	for (ink = openfile->syntax->color; ink != NULL; ink = ink->next) {
-		/* If this is not a multi-line regex, skip it. */
-		if (ink->end == NULL)
-			continue;
+	free(copy);
+	return original;
+}
 
-		for (line = openfile->filetop; line != NULL; line = line->next) {
-			int index = 0;
+/* Return copies of the given rules that have their own compiled regexes,
+ * because threads that use the same compiled regex take turns with it. */
+static const colortype **copies_of_rules(const colortype **rules)
+{
+	colortype *copies = nmalloc(rulecount * sizeof(colortype));
+	const colortype **list = nmalloc(rulecount * sizeof(colortype *));
+
+	for (int index = 0; index < rulecount; index++) {
+		copies[index] = *rules[index];
+		copies[index].start = private_copy(rules[index]->start,
+									rules[index]->start_text, rules[index]->flags);
+		copies[index].end = private_copy(rules[index]->end,
+									rules[index]->end_text, rules[index]->flags);
+		list[index] = &copies[index];
+	}
 
-			/* Assume nothing applies until proven otherwise below. */
-			line->multidata[ink->id] = NOTHING;
+	return list;
+}
 
-			/* When the line contains a start match, look for an end,
-			 * and if found, mark all the lines that are affected. */
-			while (regexec(ink->start, line->data + index, 1, &startmatch,
-										(index == 0) ? 0 : REG_NOTBOL) == 0) {
-				/* Begin looking for an end match after the start match. */
-				index += startmatch.rm_eo;
+/* Free the given copies of the given rules, except for any shared regexes. */
+static void discard_copies(const colortype **list, const colortype **rules)
+{
+	for (int index = 0; index < rulecount; index++) {
+		if (list[index]->start != rules[index]->start) {
+			regfree(list[index]->start);
+			free(list[index]->start);
+		}
+		if (list[index]->end != rules[index]->end) {
+			regfree(list[index]->end);
+			free(list[index]->end);
+		}
+	}
 
-				/* If there is an end match on this same line, mark the line,
-				 * but continue looking for other starts after it. */
-				if (regexec(ink->end, line->data + index, 1, &endmatch,
-										(index == 0) ? 0 : REG_NOTBOL) == 0) {
-					line->multidata[ink->id] = JUSTONTHIS;
+	free((colortype *)list[0]);
+	free(list);
+}
 
-					index += endmatch.rm_eo;
+/* Compute the multiline info for one rule over one chunk at a time, until
+ * no combinations are left.  As the state at the start of a chunk is not yet
+ * known, each chunk is done as if it starts outside of any region. */
+static void *precalc_chunks(void *data)
+{
+	workerstruct *worker = data;
+#ifdef TIMEPRECALC
+	struct timespec before, after;
 
-					/* If the total match has zero length, force an advance. */
-					if (startmatch.rm_eo - startmatch.rm_so + endmatch.rm_eo == 0) {
-						/* When at end-of-line, there is no other start. */
-						if (line->data[index] == '\0')
-							break;
-						index = step_right(line->data, index);
-					}
+	clock_gettime(CLOCK_THREAD_CPUTIME_ID, &before);
+	worker->tasks = 0;
+#endif
 
-					continue;
-				}
+	while (TRUE) {
+		const colortype *ink;
+		bool inside = FALSE;
+		int task, chunk;
 
-				/* Look for an end match on later lines. */
-				tailline = line->next;
+		pthread_mutex_lock(&tasklock);
+		task = nexttask++;
+		pthread_mutex_unlock(&tasklock);
 
-				while (tailline && regexec(ink->end, tailline->data, 1, &endmatch, 0) != 0)
-					tailline = tailline->next;
+		if (task >= rulecount * chunkcount)
+			break;
 
-				line->multidata[ink->id] = STARTSHERE;
+		ink = worker->rules[task / chunkcount];
+		chunk = task % chunkcount;
 
-				// Note that this also advances the line in the main loop.
-				for (line = line->next; line != tailline; line = line->next)
-					line->multidata[ink->id] = WHOLELINE;
+		for (linestruct *line = boundary[chunk]; line != boundary[chunk + 1]; line = line->next) {
+			short state = multiline_state(ink, line, inside);
 
-				if (tailline == NULL) {
-					line = openfile->filebot;
-					break;
-				}
+			line->multidata[ink->id] = state;
+			inside = (state == STARTSHERE || state == WHOLELINE);
+		}
+#ifdef TIMEPRECALC
+		worker->tasks++;
+#endif
+	}
 
-				tailline->multidata[ink->id] = ENDSHERE;
+#ifdef TIMEPRECALC
+	clock_gettime(CLOCK_THREAD_CPUTIME_ID, &after);
+	worker->busy = 1000 * (after.tv_sec - before.tv_sec) +
+							(after.tv_nsec - before.tv_nsec) / 1000000.0;
+#endif
+	return NULL;
+}
+
+/* Precalculate the multiline info with the given number of threads (the
+ * current one included), by dividing the buffer into chunks, handing out
+ * each combination of rule and chunk as a separate task, and afterward
+ * correcting the chunks that turn out to begin inside a region. */
+static void precalc_in_parallel(int threads, size_t linecount)
+{
+	const colortype **rules = nmalloc(openfile->syntax->multiscore * sizeof(colortype *));
+	workerstruct worker[MAX_WORKERS];
+	sigset_t allsignals, oldmask;
+	linestruct *line = openfile->filetop;
+	size_t counted = 0;
+	int started;
+#ifdef TIMEPRECALC
+	struct timespec start, joined, stop;
+	char timings[400] = "";
+	size_t used = 0;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+#endif
+
+	rulecount = 0;
+	for (const colortype *ink = openfile->syntax->color; ink != NULL; ink = ink->next)
+		if (ink->end != NULL)
+			rules[rulecount++] = ink;
+
+	/* Divide the buffer into chunks of roughly equal numbers of lines. */
+	chunkcount = threads * CHUNKS_PER_WORKER;
+
+	for (int chunk = 0; chunk < chunkcount; chunk++) {
+		while (counted < chunk * linecount / chunkcount) {
+			line = line->next;
+			counted++;
+		}
+		boundary[chunk] = line;
+	}
+
+	boundary[chunkcount] = NULL;
+	nexttask = 0;
+
+	/* The current thread uses the original regexes. */
+	worker[0].rules = rules;
+
+	/* Leave the handling of any signals to the current thread. */
+	sigfillset(&allsignals);
+	pthread_sigmask(SIG_SETMASK, &allsignals, &oldmask);
+
+	for (started = 1; started < threads; started++) {
+		worker[started].rules = copies_of_rules(rules);
+
+		if (pthread_create(&worker[started].thread, NULL, precalc_chunks, &worker[started]) != 0) {
+			discard_copies(worker[started].rules, rules);
+			break;
+		}
+	}
 
-				/* Look for a possible new start after the end match. */
-				index = endmatch.rm_eo;
+	pthread_sigmask(SIG_SETMASK, &oldmask, NULL);
+
+	precalc_chunks(&worker[0]);
+
+	for (int index = 1; index < started; index++) {
+		pthread_join(worker[index].thread, NULL);
+		discard_copies(worker[index].rules, rules);
+	}
+
+#ifdef TIMEPRECALC
+	clock_gettime(CLOCK_MONOTONIC, &joined);
+#endif
+
+	/* Going through the chunks in order, redo the start of each chunk that
+	 * follows an open region, until the state agrees with the earlier guess. */
+	for (int index = 0; index < rulecount; index++) {
+		const colortype *ink = rules[index];
+
+		for (int chunk = 1; chunk < chunkcount; chunk++) {
+			short prior = boundary[chunk]->prev->multidata[ink->id];
+			bool inside = (prior == STARTSHERE || prior == WHOLELINE);
+
+			if (!inside)
+				continue;
+
+			for (line = boundary[chunk]; line != boundary[chunk + 1]; line = line->next) {
+				short state = multiline_state(ink, line, inside);
+
+				if (state == line->multidata[ink->id])
+					break;
+
+				line->multidata[ink->id] = state;
+				inside = (state == STARTSHERE || state == WHOLELINE);
 			}
 		}
 	}
 
+	free(rules);
+
+#ifdef TIMEPRECALC
+	clock_gettime(CLOCK_MONOTONIC, &stop);
+
+	for (int index = 0; index < started && used < sizeof(timings); index++)
+		used += snprintf(timings + used, sizeof(timings) - used, " %.1f/%d",
+								worker[index].busy, worker[index].tasks);
+
+	statusline(NOTICE, "Precalculation: %.1f ms, stitching %.1f ms (per thread:%s)",
+				1000 * (stop.tv_sec - start.tv_sec) + (stop.tv_nsec - start.tv_nsec) / 1000000.0,
+				1000 * (stop.tv_sec - joined.tv_sec) + (stop.tv_nsec - joined.tv_nsec) / 1000000.0,
+				timings);
+	napms(1200);
+#endif
+}
+#endif /* USE_POSIX_THREADS */
+
+/* Precalculate the multi-line start and end regex info so we can
+ * speed up rendering (with any hope at all...).  As the info for one
+ * regex does not depend on the other regexes, do a separate pass over
+ * the buffer for each of them, which keeps each regex hot in the cache.
+ * For a large buffer on a machine with several processors, spread these
+ * passes, cut into chunks, over a number of threads. */
+void precalc_multicolorinfo(void)
+{
+	linestruct *line;
+	size_t linecount = 0;
+#ifdef USE_POSIX_THREADS
+	long threads = sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+
+	if (!openfile->syntax || openfile->syntax->multiscore == 0 || ISSET(NO_SYNTAX))
+		return;
+
+	for (line = openfile->filetop; line != NULL; line = line->next) {
+		if (line->multidata == NULL)
+			line->multidata = nmalloc(openfile->syntax->multiscore * sizeof(short));
+		linecount++;
+	}
+
+#ifdef USE_POSIX_THREADS
+	if (threads > (long)(linecount / LINES_PER_WORKER))
+		threads = linecount / LINES_PER_WORKER;
+	if (threads > MAX_WORKERS)
+		threads = MAX_WORKERS;
+
+	if (threads > 1) {
+		precalc_in_parallel(threads, linecount);
+		return;
+	}
+#endif
+
+#ifdef TIMEPRECALC
+	clock_t start = clock(), lap = start;
+	char timings[200] = "";
+	size_t used = 0;
+#endif
+
+	for (const colortype *ink = openfile->syntax->color; ink != NULL; ink = ink->next) {
+		bool inside = FALSE;
+
+		/* If this is not a multi-line regex, skip it. */
+		if (ink->end == NULL)
+			continue;
+
+		for (line = openfile->filetop; line != NULL; line = line->next) {
+			short state = multiline_state(ink, line, inside);
+
+			line->multidata[ink->id] = state;
+			inside = (state == STARTSHERE || state == WHOLELINE);
+		}
+
+#ifdef TIMEPRECALC
+		if (used < sizeof(timings))
+			used += snprintf(timings + used, sizeof(timings) - used, " %.1f",
+								1000 * (double)(clock() - lap) / CLOCKS_PER_SEC);
+		lap = clock();
+#endif
+	}
+
 #ifdef TIMEPRECALC
-	statusline(NOTICE, "Precalculation: %.1f ms", 1000 * (double)(clock() - start) / CLOCKS_PER_SEC);
+	statusline(NOTICE, "Precalculation: %.1f ms (per regex:%s)",
+				1000 * (double)(clock() - start) / CLOCKS_PER_SEC, timings);
 	napms(1200);
 #endif
 }
@@ -49,6 +49,7 @@ void expunge(undo_type action)
 		memmove(&openfile->current->data[openfile->current_x],
 					&openfile->current->data[openfile->current_x + charlen],
 					line_len - charlen + 1);
+		mark_as_changed(openfile->current);
 #ifndef NANO_TINY
 		/* When softwrapping, a changed number of chunks requires a refresh. */
 		if (ISSET(SOFTWRAP) && extra_chunks_in(openfile->current) != old_amount)
@@ -89,29 +90,32 @@ void expunge(undo_type action)
 		openfile->current->data = nrealloc(openfile->current->data,
 				strlen(openfile->current->data) + strlen(joining->data) + 1);
 		strcat(openfile->current->data, joining->data);
+		mark_as_changed(openfile->current);
 
 		unlink_node(joining);
 
 		/* Two lines were joined, so do a renumbering and refresh the screen. */
-		renumber_from(openfile->current);
+		renumber_lazily_from(openfile->current, openfile->current);
 		refresh_needed = TRUE;
 	} else
 		/* We're at the end-of-file: nothing to do. */
 		return;
 
-#ifdef ENABLE_COLOR
-	if (!refresh_needed)
-		check_the_multis(openfile->current);
-#endif
-	if (!refresh_needed)
-		update_line(openfile->current, openfile->current_x);
-
 	/* Adjust the file size, and remember it for a possible redo. */
 	openfile->totsize--;
 #ifndef NANO_TINY
 	openfile->current_undo->newsize = openfile->totsize;
 #endif
+	/* Mark the buffer as modified before redrawing, so that no cached
+	 * information about the changed line gets used. */
 	set_modified();
+
+#ifdef ENABLE_COLOR
+	if (!refresh_needed)
+		check_the_multis(openfile->current);
+#endif
+	if (!refresh_needed)
+		update_line(openfile->current, openfile->current_x);
 }
 
 /* Delete the character under the cursor plus any succeeding zero-widths,
@@ -253,14 +257,22 @@ void chop_next_word(void)
 void extract_segment(linestruct *top, size_t top_x, linestruct *bot, size_t bot_x)
 {
 	linestruct *taken, *last;
-	bool edittop_inside = (openfile->edittop->lineno >= top->lineno &&
-							openfile->edittop->lineno <= bot->lineno);
+	bool edittop_inside;
 #ifndef NANO_TINY
 	bool same_line = (openfile->mark == top);
-	bool post_marked = (openfile->mark && (openfile->mark->lineno > top->lineno ||
-						(same_line && openfile->mark_x > top_x)));
+	bool post_marked;
 	static bool inherited_anchor = FALSE;
 	bool had_anchor = top->has_anchor;
+#endif
+
+	/* An earlier excision or insertion may have left later numbers outdated. */
+	finish_renumbering();
+
+	edittop_inside = (openfile->edittop->lineno >= top->lineno &&
+						openfile->edittop->lineno <= bot->lineno);
+#ifndef NANO_TINY
+	post_marked = (openfile->mark && (openfile->mark->lineno > top->lineno ||
+						(same_line && openfile->mark_x > top_x)));
 
 	if (top == bot && top_x == bot_x)
 		return;
@@ -270,14 +282,21 @@ void extract_segment(linestruct *top, size_t top_x, linestruct *bot, size_t bot_
 			had_anchor |= line->has_anchor;
 #endif
 
+	/* The lines that are made here get the number of the line that they
+	 * stem from, so that marking them as changed upsets little. */
 	if (top == bot) {
 		taken = make_new_node(NULL);
+		taken->lineno = top->lineno;
 		taken->data = measured_copy(top->data + top_x, bot_x - top_x);
 		memmove(top->data + top_x, top->data + bot_x, strlen(top->data + bot_x) + 1);
+		mark_as_changed(top);
 		last = taken;
 	} else if (top_x == 0 && bot_x == 0) {
+		drop_milestones(top, bot->prev);
+
 		taken = top;
 		last = make_new_node(NULL);
+		last->lineno = bot->lineno;
 		last->data = copy_of("");
 #ifndef NANO_TINY
 		last->has_anchor = bot->has_anchor;
@@ -294,7 +313,10 @@ void extract_segment(linestruct *top, size_t top_x, linestruct *bot, size_t bot_
 
 		openfile->current = bot;
 	} else {
+		drop_milestones(top->next, bot);
+
 		taken = make_new_node(NULL);
+		taken->lineno = top->lineno;
 		taken->data = copy_of(top->data + top_x);
 		taken->next = top->next;
 		top->next->prev = taken;
@@ -305,10 +327,12 @@ void extract_segment(linestruct *top, size_t top_x, linestruct *bot, size_t bot_
 
 		top->data = nrealloc(top->data, top_x + strlen(bot->data + bot_x) + 1);
 		strcpy(top->data + top_x, bot->data + bot_x);
+		mark_as_changed(top);
 
 		last = bot;
 		last->data[bot_x] = '\0';
 		last->next = NULL;
+		mark_as_changed(last);
 
 		openfile->current = top;
 	}
@@ -328,6 +352,7 @@ void extract_segment(linestruct *top, size_t top_x, linestruct *bot, size_t bot_
 		cutbottom->data = nrealloc(cutbottom->data,
 							strlen(cutbottom->data) + strlen(taken->data) + 1);
 		strcat(cutbottom->data, taken->data);
+		mark_as_changed(cutbottom);
 #ifndef NANO_TINY
 		cutbottom->has_anchor = taken->has_anchor && !inherited_anchor;
 		inherited_anchor |= taken->has_anchor;
@@ -354,7 +379,7 @@ void extract_segment(linestruct *top, size_t top_x, linestruct *bot, size_t bot_
 	if (openfile->filebot == bot)
 		openfile->filebot = openfile->current;
 
-	renumber_from(openfile->current);
+	renumber_lazily_from(openfile->current, openfile->current);
 
 	/* When the beginning of the viewport was inside the excision, adjust. */
 	if (edittop_inside) {
@@ -395,6 +420,7 @@ void ingraft_buffer(linestruct *topline)
 		line->data = nrealloc(line->data, length + extralen + 1);
 		memmove(line->data + xpos + extralen, line->data + xpos, length - xpos + 1);
 		strncpy(line->data + xpos, topline->data, extralen);
+		mark_as_changed(line);
 	}
 
 	if (topline != botline) {
@@ -403,6 +429,7 @@ void ingraft_buffer(linestruct *topline)
 			openfile->filebot = botline;
 
 		line->data[xpos + extralen] = '\0';
+		mark_as_changed(line);
 
 		/* Hook the grafted lines in after the current one. */
 		botline->next = openfile->current->next;
@@ -416,6 +443,7 @@ void ingraft_buffer(linestruct *topline)
 		extralen = strlen(tailtext);
 		botline->data = nrealloc(botline->data, length + extralen + 1);
 		strcpy(botline->data + length, tailtext);
+		mark_as_changed(botline);
 
 		/* Put the cursor at the end of the grafted text. */
 		openfile->current = botline;
@@ -435,7 +463,7 @@ void ingraft_buffer(linestruct *topline)
 	delete_node(topline);
 	free(tailtext);
 
-	renumber_from(line);
+	renumber_lazily_from(line, openfile->current);
 
 	/* If the text doesn't end with a newline, and it should, add one. */
 	if (!ISSET(NO_NEWLINES) && openfile->filebot->data[0])
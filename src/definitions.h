@@ -155,6 +155,9 @@
 /* The largest size_t number that doesn't have the high bit set. */
 #define HIGHEST_POSITIVE  ((~(size_t)0) >> 1)
 
+/* The number of bytes after which to stop painting, to avoid major slowdowns. */
+#define PAINT_LIMIT  2000
+
 #ifdef ENABLE_COLOR
 #define THE_DEFAULT  -1
 #define BAD_COLOR  -2
@@ -380,7 +383,9 @@ enum {
 	MINIBAR,
 	ZERO,
 	MODERN_BINDINGS,
-	SOLO_SIDESCROLL
+	SOLO_SIDESCROLL,
+	SHOW_MATCHES,
+	BACKGROUND_SAVE
 };
 
 /* Structure types. */
@@ -400,6 +405,16 @@ typedef struct colortype {
 		/* The compiled regular expression for 'start=', or the only one. */
 	regex_t *end;
 		/* The compiled regular expression for 'end=', if any. */
+	unsigned char *leaders;
+		/* A bitmap of the bytes that can begin a match, or NULL for "any". */
+#ifdef USE_POSIX_THREADS
+	char *start_text;
+		/* The source of the 'start=' regex of a multiline rule, else NULL. */
+	char *end_text;
+		/* The source of the 'end=' regex of a multiline rule, else NULL. */
+	int flags;
+		/* The flags with which the above regexes were compiled. */
+#endif
 	struct colortype *next;
 		/* Next color combination. */
 } colortype;
@@ -469,8 +484,41 @@ typedef struct lintstruct {
 	struct lintstruct *prev;
 		/* Previous error. */
 } lintstruct;
+
+typedef struct spanstruct {
+	const colortype *ink;
+		/* The single-line regex that matched. */
+	int start;
+		/* Where the match begins in the line (in bytes). */
+	int end;
+		/* Where the match ends. */
+} spanstruct;
+
+typedef struct paintstruct {
+	unsigned int version;
+		/* The version of the line at the moment these matches were found. */
+	const syntaxtype *syntax;
+		/* The syntax whose regexes were matched. */
+	size_t count;
+		/* How many matches there are. */
+	spanstruct span[];
+		/* The matches themselves, in the order of the regexes. */
+} paintstruct;
 #endif /* ENABLE_COLOR */
 
+#ifndef NANO_TINY
+typedef struct chunkstruct {
+	unsigned int version;
+		/* The version of the line at the moment the chunks were determined. */
+	int width;
+		/* The width of the chunks, doubled, plus one when breaking at blanks. */
+	size_t count;
+		/* How many chunks the line consists of. */
+	size_t edge[];
+		/* The leftmost column of each of these chunks. */
+} chunkstruct;
+#endif
+
 /* More structure types. */
 typedef struct linestruct {
 	char *data;
@@ -489,9 +537,77 @@ typedef struct linestruct {
 	bool has_anchor;
 		/* Whether the user has placed an anchor at this line. */
 #endif
+	bool is_milestone;
+		/* Whether this line serves as a starting point for lookups by number. */
+	unsigned int version;
+		/* A number that changes whenever the text of this line is changed. */
 } linestruct;
 
+typedef struct milestonestruct {
+	linestruct *line;
+		/* A line that serves as a starting point for lookups. */
+	size_t tally;
+		/* The number of characters before this line; zero when unknown. */
+} milestonestruct;
+
+typedef struct batchstruct {
+	linestruct *nodes;
+		/* The line nodes that were allocated in one go. */
+	linestruct *spare;
+		/* The unused ones among them, chained through their next pointers. */
+	int in_use;
+		/* How many of these nodes are in use. */
+	struct batchstruct *next;
+		/* Next batch that has unused nodes. */
+	struct batchstruct *prev;
+		/* Previous batch that has unused nodes. */
+} batchstruct;
+
+typedef struct checkstruct {
+	unsigned int version;
+		/* The version of the line at the moment the checkpoints were started. */
+	size_t count;
+		/* How many checkpoints have been set so far. */
+	size_t room;
+		/* For how many checkpoints there is space in the arrays. */
+	size_t *x;
+		/* The byte offset of each checkpoint: the first character boundary
+		 * at or after every multiple of the checkpoint gap. */
+	size_t *column;
+		/* The column that corresponds to each of these byte offsets. */
+} checkstruct;
+
+typedef struct cachestruct {
+	const linestruct *line;
+		/* The line from whose text the information below was derived. */
+	size_t used;
+		/* When this entry was last looked up. */
+#ifdef ENABLE_COLOR
+	paintstruct *paint;
+		/* The cached matches of the single-line regexes in the line. */
+#endif
 #ifndef NANO_TINY
+	chunkstruct *chunks;
+		/* The cached starting columns of the softwrapped chunks. */
+#endif
+	checkstruct *checks;
+		/* The byte offsets and columns of regularly spaced points in a long line. */
+} cachestruct;
+
+#ifndef NANO_TINY
+typedef struct rowstruct {
+	const linestruct *line;
+		/* The line whose text is shown on this row, or NULL when unknown. */
+	size_t column;
+		/* The column from which the line is shown on this row. */
+	unsigned int version;
+		/* The version of the line at the moment the row was drawn. */
+	ssize_t lineno;
+		/* The number of the line at that moment. */
+	bool anchor;
+		/* Whether the line had an anchor at that moment. */
+} rowstruct;
+
 typedef struct groupstruct {
 	ssize_t top_line;
 		/* First line of group. */
@@ -518,6 +634,10 @@ typedef struct undostruct {
 		/* The file size before the action. */
 	size_t newsize;
 		/* The file size after the action. */
+	size_t weight;
+		/* The memory taken by this item; zero until the item is complete. */
+	off_t spot;
+		/* Where the data of this item were written in the journal, or -1. */
 	groupstruct *grouping;
 		/* Undo info specific to groups of lines. */
 	linestruct *cutbuffer;
@@ -570,6 +690,20 @@ typedef struct openfilestruct {
 		/* From which column the edit window is drawn (when panning). */
 	ssize_t cursor_row;
 		/* The row in the edit window that the cursor is on. */
+	linestruct *renumber_point;
+		/* The first line whose number is outdated, if any. */
+	milestonestruct *milestones;
+		/* Lines spread over the buffer, in order, for lookups by number. */
+	size_t milestone_count;
+		/* The number of lines in the above array. */
+	size_t milestone_room;
+		/* The number of lines that the above array can hold. */
+	ssize_t tally_low;
+		/* The highest line number up to which the tallies are still right. */
+	ssize_t tally_tail;
+		/* Beyond how many lines before the end the tallies might be off. */
+	size_t tally_size;
+		/* The size of the buffer when the tallies were last brought up to date. */
 	struct stat *statinfo;
 		/* The file's stat information from when it was opened or last saved. */
 #ifdef ENABLE_WRAPPING
@@ -593,8 +727,23 @@ typedef struct openfilestruct {
 		/* The current (i.e. next) level of undo. */
 	undostruct *last_saved;
 		/* The undo item at which the file was last saved. */
+	size_t undo_weight;
+		/* The memory taken by the completed items in the undo list,
+		 * not counting the data that were moved to the journal. */
 	undo_type last_action;
 		/* The type of the last action the user performed. */
+	char *mapping;
+		/* The mapped file whose rest is still being read in, if any. */
+	size_t mapsize;
+		/* The number of bytes in that mapping. */
+	size_t sliced;
+		/* How many bytes of the mapping have been sliced into lines. */
+	pid_t saver;
+		/* The process that is writing out a snapshot of the buffer, if any. */
+	int tidings;
+		/* The reading end of the pipe through which that process reports. */
+	undostruct *snapshot;
+		/* The undo item at which that snapshot was taken. */
 #endif
 	bool modified;
 		/* Whether the file has been modified. */
@@ -645,6 +794,22 @@ typedef struct keystruct {
 		/* Next in the list. */
 } keystruct;
 
+/* The number of lowest keycodes that get a direct slot in a keytable. */
+#define DIRECT_KEYCODES  0x200
+
+typedef struct keytable {
+	int menus;
+		/* The menu (or combination of menus) for which the table was made. */
+	const keystruct *direct[DIRECT_KEYCODES];
+		/* The shortcut that each of the lower keycodes is bound to, if any. */
+	const keystruct **hashed;
+		/* The shortcuts for the higher keycodes, hashed by keycode. */
+	size_t hashsize;
+		/* The number of slots in the above hash table: a power of two. */
+	struct keytable *next;
+		/* Next in the list. */
+} keytable;
+
 typedef struct funcstruct {
 	void (*func)(void);
 		/* The actual function to call. */
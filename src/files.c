@@ -27,12 +27,33 @@
 #ifdef HAVE_PWD_H
 #include <pwd.h>
 #endif
+#include <setjmp.h>
 #include <string.h>
+#include <time.h>
 #include <unistd.h>
+#ifdef HAVE_LINUX_FS_H
+#include <linux/fs.h>
+#include <sys/ioctl.h>
+#endif
+#ifdef HAVE_SYS_MMAN_H
+#include <sys/mman.h>
+#endif
+#ifdef HAVE_SYS_SENDFILE_H
+#include <sys/sendfile.h>
+#endif
 #include <sys/wait.h>
 
 #define RW_FOR_ALL  (S_IRUSR | S_IWUSR | S_IRGRP | S_IWGRP | S_IROTH | S_IWOTH)
 
+/* A file bigger than this gets read in piecemeal, after its first lines. */
+#define STREAMING_SIZE  (64 * 1024 * 1024)
+
+/* The number of lines to read before showing such a file. */
+#define LINES_UP_FRONT  10000
+
+/* With 'backgroundsave', a buffer at least this big gets saved by a child. */
+#define BACKGROUND_SIZE  (16 * 1024 * 1024)
+
 #ifndef HAVE_FSYNC
 # define fsync(...)  0
 #endif
@@ -75,6 +96,13 @@ void make_new_buffer(void)
 	openfile->placewewant = 0;
 	openfile->brink = 0;
 	openfile->cursor_row = 0;
+	openfile->renumber_point = NULL;
+	openfile->milestones = NULL;
+	openfile->milestone_count = 0;
+	openfile->milestone_room = 0;
+	openfile->tally_low = HIGHEST_POSITIVE;
+	openfile->tally_tail = HIGHEST_POSITIVE;
+	openfile->tally_size = 0;
 
 	openfile->edittop = openfile->filetop;
 	openfile->firstcolumn = 0;
@@ -93,7 +121,10 @@ void make_new_buffer(void)
 	openfile->undotop = NULL;
 	openfile->current_undo = NULL;
 	openfile->last_saved = NULL;
+	openfile->undo_weight = 0;
 	openfile->last_action = OTHER;
+	openfile->mapping = NULL;
+	openfile->saver = 0;
 
 	openfile->statinfo = NULL;
 	openfile->lock_filename = NULL;
@@ -495,6 +526,8 @@ bool open_buffer(const char *filename, bool new_one)
  * then update the title bar to display the buffer's new status. */
 void set_modified(void)
 {
+	edit_count++;
+
 	if (openfile->modified)
 		return;
 
@@ -515,9 +548,7 @@ void prepare_for_display(void)
 		titlebar(NULL);
 
 #ifdef ENABLE_COLOR
-	/* Precalculate the data for any multiline coloring regexes. */
-	if (!openfile->filetop->multidata)
-		precalc_multicolorinfo();
+	/* The data for any multiline coloring regexes gets computed when needed. */
 	have_palette = FALSE;
 #endif
 	refresh_needed = TRUE;
@@ -608,12 +639,17 @@ void close_buffer(void)
 	orphan->next->prev = orphan->prev;
 
 	free(orphan->filename);
+	discard_milestones();
 	free_lines(orphan->filetop);
 #ifndef NANO_TINY
 	free(orphan->statinfo);
 	free(orphan->lock_filename);
 	/* Free the undo stack. */
 	discard_until(NULL);
+#ifdef HAVE_MMAP
+	if (orphan->mapping)
+		munmap(orphan->mapping, orphan->mapsize);
+#endif
 #endif
 	free(orphan->errormessage);
 
@@ -623,25 +659,134 @@ void close_buffer(void)
 
 	free(orphan);
 
+	/* Make sure that no cached information about the freed lines gets used. */
+	edit_count++;
+
 	/* When just one buffer remains open, show "Exit" in the help lines. */
 	if (openfile && openfile == openfile->next)
 		exitfunc->tag = exit_tag;
 }
 #endif /* ENABLE_MULTIBUFFER */
 
-/* Encode any NUL bytes in the given line of text (of the given length),
- * and return a dynamically allocated copy of the resultant string. */
-char *encode_data(char *text, size_t length)
+/* Make a copy of the given line of text (of the given length), encode
+ * any NUL bytes in the copy, and return this dynamically allocated copy. */
+char *encode_data(const char *text, size_t length)
 {
-	recode_NUL_to_LF(text, length);
-	text[length] = '\0';
+	char *thecopy = measured_copy(text, length);
+
+	recode_NUL_to_LF(thecopy, length);
 
-	return copy_of(text);
+	return thecopy;
 }
 
 /* The number of bytes by which we expand the line buffer while reading. */
 #define LUMPSIZE  120
 
+#ifdef HAVE_MMAP
+static sigjmp_buf mapping_is_gone;
+		/* Where to resume when a file shrank while it was being read. */
+
+/* Handle a SIGBUS, which is raised when a part of a mapped file is accessed
+ * that no longer exists because the file was truncated in the meantime. */
+static void abandon_the_mapping(int signal)
+{
+	siglongjmp(mapping_is_gone, 1);
+}
+
+/* Slice the given mapped file into lines, starting at offset *sliced and
+ * stopping after at most the given number of lines, storing them from the
+ * given bottom line onward, and return the new bottom line.  Advance *sliced
+ * past what was consumed, count the lines in *lines, and note in *format
+ * whether the first line break of the file is a DOS one.  An unterminated
+ * last line goes into the returned bottom line; otherwise its data is NULL. */
+static linestruct *slice_the_mapping(const char *mapping, size_t mapsize, size_t *sliced,
+						size_t most, linestruct *bottom, size_t *lines, format_type *format)
+{
+	linestruct *volatile bottomline = bottom;
+		/* The line that is being filled; it survives a jump. */
+	volatile size_t num_lines = 0;
+		/* The number of lines sliced off so far. */
+	volatile format_type kind = *format;
+		/* The type of line ending of the first line. */
+	const char *from = mapping + *sliced;
+		/* Where the slicing starts. */
+	struct sigaction newaction, oldaction;
+
+#ifdef MADV_SEQUENTIAL
+	madvise((void *)mapping, mapsize, MADV_SEQUENTIAL);
+#endif
+	/* When the file gets truncated while it is being read, stop reading
+	 * there, as if the end of the file was reached. */
+	newaction.sa_handler = abandon_the_mapping;
+	sigemptyset(&newaction.sa_mask);
+	newaction.sa_flags = 0;
+	sigaction(SIGBUS, &newaction, &oldaction);
+
+	/* When the reading gets cut short by a truncation, it is finished. */
+	*sliced = mapsize;
+
+	if (sigsetjmp(mapping_is_gone, 1) == 0) {
+		const char *end = mapping + mapsize;
+		const char *start = from;
+		time_t lastreport = time(NULL) + 1;
+			/* Reporting begins only after a full second has passed. */
+
+		while (!control_C_was_pressed && start < end && num_lines < most) {
+			const char *newline = memchr(start, '\n', end - start);
+			size_t len = (newline ? newline : end) - start;
+
+#ifndef NANO_TINY
+			if (newline && len > 0 && start[len - 1] == '\r' && !ISSET(NO_CONVERT)) {
+				if (start == mapping)
+					kind = DOS_FILE;
+				len--;
+			}
+#endif
+			/* Copy the line straight into the node, so that a SIGBUS
+			 * during the copying does not leave an orphaned allocation. */
+			bottomline->data = nmalloc(len + 1);
+			memcpy(bottomline->data, start, len);
+			bottomline->data[len] = '\0';
+			recode_NUL_to_LF(bottomline->data, len);
+			num_lines++;
+
+			/* Any bytes after the last newline form the last line. */
+			if (newline == NULL) {
+				start = end;
+				break;
+			}
+
+			bottomline->next = make_new_node(bottomline);
+			bottomline = bottomline->next;
+
+			start = newline + 1;
+
+			/* Once a second, report how far the reading has progressed. */
+			if (time(NULL) - lastreport > 0 && (!ISSET(ZERO) || we_are_running)) {
+				size_t percentage = (start - mapping) / (mapsize / 100 + 1);
+
+				statusline(HUSH, P_("Reading... %zu%% (%zu line)",
+						"Reading... %zu%% (%zu lines)", num_lines), percentage, num_lines);
+				lastreport = time(NULL);
+			}
+		}
+
+		*sliced = start - mapping;
+	} else {
+		/* Drop the partial copy of the line that was being read. */
+		free(bottomline->data);
+		bottomline->data = NULL;
+	}
+
+	sigaction(SIGBUS, &oldaction, NULL);
+
+	*lines = num_lines;
+	*format = kind;
+
+	return bottomline;
+}
+#endif
+
 /* Read the given open file f into the current buffer.  filename should be
  * set to the name of the file.  undoable means that undo records should be
  * created and that the file does not need to be checked for writability. */
@@ -659,6 +804,18 @@ void read_file(FILE *f, int fd, const char *filename, bool undoable)
 		/* The size of the line buffer; increased as needed. */
 	char *buf = nmalloc(bufsize);
 		/* The buffer in which we assemble each line of the file. */
+#ifdef HAVE_MMAP
+	struct stat fileinfo;
+		/* For checking whether we are reading a regular file. */
+	void *mapping = MAP_FAILED;
+		/* Where the file is mapped into memory, when this is possible. */
+	size_t mapsize = 0;
+		/* The number of bytes that were mapped. */
+	size_t sliced = 0;
+		/* How many of those bytes were sliced into lines. */
+	size_t most = HIGHEST_POSITIVE;
+		/* The maximum number of lines to read right now. */
+#endif
 	linestruct *topline;
 		/* The top of the new buffer where we store the read file. */
 	linestruct *bottomline;
@@ -669,10 +826,10 @@ void read_file(FILE *f, int fd, const char *filename, bool undoable)
 		/* The error code, in case an error occurred during reading. */
 	bool writable = TRUE;
 		/* Whether the file is writable (in case we care). */
-#ifndef NANO_TINY
 	format_type format = NIX_FILE;
 		/* The type of line ending the file uses: Unix or DOS. */
 
+#ifndef NANO_TINY
 	if (undoable)
 		add_undo(INSERT, NULL);
 
@@ -698,6 +855,28 @@ void read_file(FILE *f, int fd, const char *filename, bool undoable)
 
 	control_C_was_pressed = FALSE;
 
+#ifdef HAVE_MMAP
+	/* When it is a regular, nonempty file, try to map it into memory. */
+	if (fd > 0 && fstat(fd, &fileinfo) == 0 && S_ISREG(fileinfo.st_mode) &&
+				fileinfo.st_size > 0 && fileinfo.st_size <= HIGHEST_POSITIVE) {
+		mapsize = fileinfo.st_size;
+		mapping = mmap(NULL, mapsize, PROT_READ, MAP_PRIVATE, fd, 0);
+	}
+
+#ifndef NANO_TINY
+	/* Of a large file that goes into a buffer of its own, read only the first
+	 * lines now, and leave the rest to be read in while the user looks. */
+	if (mapping != MAP_FAILED && !undoable && mapsize > STREAMING_SIZE)
+		most = LINES_UP_FRONT;
+#endif
+
+	/* If the mapping succeeded, slice the file into lines with memchr(),
+	 * copying each line in one go instead of reading byte by byte. */
+	if (mapping != MAP_FAILED)
+		bottomline = slice_the_mapping(mapping, mapsize, &sliced, most,
+										bottomline, &num_lines, &format);
+	else
+#endif /* HAVE_MMAP */
 	/* Read in the entire file, byte by byte, line by line. */
 	while ((onevalue = getc_unlocked(f)) != EOF) {
 		char input = (char)onevalue;
@@ -776,18 +955,30 @@ void read_file(FILE *f, int fd, const char *filename, bool undoable)
 
 	/* If the file ended with a newline, or it was entirely empty, make the
 	 * last line blank.  Otherwise, put the last read data in. */
-	if (len == 0)
-		bottomline->data = copy_of("");
-	else {
+	if (len > 0) {
 		bottomline->data = encode_data(buf, len);
 		num_lines++;
-	}
+	} else if (bottomline->data == NULL)
+		bottomline->data = copy_of("");
 
 	free(buf);
 
 	/* Insert the just read buffer into the current one. */
 	ingraft_buffer(topline);
 
+#ifdef HAVE_MMAP
+#ifndef NANO_TINY
+	/* When not everything was read, keep the mapping for reading the rest. */
+	if (mapping != MAP_FAILED && sliced < mapsize && !control_C_was_pressed) {
+		openfile->mapping = mapping;
+		openfile->mapsize = mapsize;
+		openfile->sliced = sliced;
+	} else
+#endif
+	if (mapping != MAP_FAILED)
+		munmap(mapping, mapsize);
+#endif
+
 	/* Set the desired x position at the end of what was inserted. */
 	openfile->placewewant = xplustabs();
 
@@ -796,6 +987,8 @@ void read_file(FILE *f, int fd, const char *filename, bool undoable)
 	else if ((ISSET(ZERO) || ISSET(MINIBAR)) && !(we_are_running && undoable))
 		;  /* No blurb for new buffers with --zero or --mini. */
 #ifndef NANO_TINY
+	else if (openfile->mapping)
+		wipe_statusbar();  /* The title bar shows the progress instead. */
 	else if (format == DOS_FILE)
 		/* TRANSLATORS: Keep the next two messages at most 78 characters. */
 		statusline(REMARK, P_("Read %zu line (converted from DOS format)",
@@ -827,6 +1020,86 @@ void read_file(FILE *f, int fd, const char *filename, bool undoable)
 #endif
 }
 
+#ifndef NANO_TINY
+/* Read at most the given number of lines more of the file that is being read
+ * in piecemeal, appending them to the current buffer.  When the end of the
+ * file is reached, let go of the mapping. */
+void continue_loading(size_t howmany)
+{
+#ifdef HAVE_MMAP
+	linestruct *bottom = openfile->filebot;
+	ssize_t was_lineno = bottom->lineno;
+	format_type format = NIX_FILE;
+	size_t lines;
+
+	if (openfile->mapping == NULL)
+		return;
+
+	control_C_was_pressed = FALSE;
+
+	/* The empty last line gets filled with the first line that is read. */
+	free(bottom->data);
+	bottom->data = NULL;
+#ifdef ENABLE_COLOR
+	free(bottom->multidata);
+	bottom->multidata = NULL;
+#endif
+	mark_as_changed(bottom);
+
+	openfile->filebot = slice_the_mapping(openfile->mapping, openfile->mapsize,
+						&openfile->sliced, howmany, bottom, &lines, &format);
+
+	if (openfile->filebot->data == NULL)
+		openfile->filebot->data = copy_of("");
+
+	openfile->totsize += number_of_characters_in(bottom, openfile->filebot);
+
+	if (openfile->sliced == openfile->mapsize) {
+		munmap(openfile->mapping, openfile->mapsize);
+		openfile->mapping = NULL;
+	}
+
+	upset_the_tallies(was_lineno - 1, openfile->filebot->lineno);
+
+	/* Make sure that nothing cached about the last line gets used. */
+	edit_count++;
+#endif
+}
+
+/* Read in the file that is being read piecemeal up to the given line number,
+ * or to its end, allowing ^C to interrupt this.  Return FALSE if it was. */
+bool load_up_to(ssize_t number)
+{
+	if (openfile->mapping == NULL || number < openfile->filebot->lineno)
+		return TRUE;
+
+	install_handler_for_Ctrl_C();
+
+	continue_loading(number - openfile->filebot->lineno + 1);
+
+	restore_handler_for_Ctrl_C();
+
+	titlebar(NULL);
+
+	if (control_C_was_pressed) {
+		statusline(ALERT, _("Interrupted"));
+		return FALSE;
+	}
+
+	/* Remove any progress report. */
+	if (lastmessage == HUSH)
+		wipe_statusbar();
+
+	return TRUE;
+}
+
+/* Read in all of the rest of the file that is being read piecemeal. */
+bool finish_loading(void)
+{
+	return load_up_to(HIGHEST_POSITIVE);
+}
+#endif /* !NANO_TINY */
+
 /* Open the file with the given name.  If the file does not exist, display
  * "New File" if new_one is TRUE, and say "File not found" otherwise.
  * Return 0 if we say "New File", -1 upon failure, and the obtained file
@@ -1515,6 +1788,42 @@ void init_backup_dir(void)
 }
 #endif
 
+/* Try to let the kernel copy the rest of the file at descriptor inn to the
+ * file at descriptor out, without passing the data through user space: by
+ * sharing the data blocks (when out is empty and the filesystem supports
+ * this), or by copying them within the kernel.  Return TRUE when the whole
+ * file was copied; otherwise the caller should copy what remains. */
+bool copy_in_kernel(int inn, int out)
+{
+	struct stat info;
+	ssize_t copied = -1;
+
+	/* Files without a meaningful size (like in /proc) must be read normally. */
+	if (fstat(inn, &info) < 0 || !S_ISREG(info.st_mode) || info.st_size == 0)
+		return FALSE;
+
+#ifdef FICLONE
+	if (lseek(inn, 0, SEEK_CUR) == 0 && lseek(out, 0, SEEK_CUR) == 0 &&
+				fstat(out, &info) == 0 && S_ISREG(info.st_mode) && info.st_size == 0 &&
+				ioctl(out, FICLONE, inn) == 0) {
+		lseek(inn, 0, SEEK_END);
+		lseek(out, 0, SEEK_END);
+		return TRUE;
+	}
+#endif
+#ifdef HAVE_COPY_FILE_RANGE
+	while ((copied = copy_file_range(inn, NULL, out, NULL, SSIZE_MAX >> 1, 0)) > 0)
+		;
+	if (copied == 0)
+		return TRUE;
+#endif
+#if defined(HAVE_SENDFILE) && defined(HAVE_SYS_SENDFILE_H)
+	while ((copied = sendfile(out, inn, NULL, SSIZE_MAX >> 1)) > 0)
+		;
+#endif
+	return (copied == 0);
+}
+
 /* Read all data from `inn`, and write it to `out`.  File `inn` must be open
  * for reading, and `out` for writing.  Return 0 on success, a negative number
  * on read error, and a positive number on write error.  File `inn` is always
@@ -1526,17 +1835,20 @@ int copy_file(FILE *inn, FILE *out, bool close_out)
 	size_t charsread;
 	int retval = 0;
 
-	do {
-		charsread = fread(buf, 1, BUFSIZ, inn);
-		if (charsread == 0 && ferror(inn)) {
-			retval = -1;
-			break;
-		}
-		if (fwrite(buf, 1, charsread, out) < charsread) {
-			retval = 2;
-			break;
-		}
-	} while (charsread > 0);
+	/* Copy through a buffer only what the kernel could not copy by itself. */
+	if (fflush(out) == EOF || !copy_in_kernel(fileno(inn), fileno(out))) {
+		do {
+			charsread = fread(buf, 1, BUFSIZ, inn);
+			if (charsread == 0 && ferror(inn)) {
+				retval = -1;
+				break;
+			}
+			if (fwrite(buf, 1, charsread, out) < charsread) {
+				retval = 2;
+				break;
+			}
+		} while (charsread > 0);
+	}
 
 	if (fclose(inn) == EOF)
 		retval = -3;
@@ -1707,6 +2019,210 @@ bool make_backup_of(char *realname, struct stat fileinfo)
 }
 #endif /* !NANO_TINY */
 
+/* The number of bytes that are gathered before they are handed to fwrite(). */
+#define BATCHSIZE  262144
+
+/* Write the lines from the given one to the end of the buffer to the given
+ * stream, gathering them into large batches, and turning any LFs in the text
+ * back into the NULs that they represent.  Count the written lines in count.
+ * Return FALSE when a write fails (with errno set), TRUE otherwise. */
+bool write_lines(FILE *stream, const linestruct *line, size_t *count)
+{
+	char *batch = nmalloc(BATCHSIZE);
+	size_t filled = 0;
+	bool okay = TRUE;
+	int errnumber;
+
+	while (okay) {
+		const char *text = line->data;
+		size_t remainder = strlen(text);
+
+		/* Copy the text of the line into the batch, emptying the batch
+		 * onto the stream whenever it is full. */
+		while (remainder > 0 && okay) {
+			size_t amount = (remainder < BATCHSIZE - filled) ? remainder : BATCHSIZE - filled;
+			char *spot = batch + filled;
+
+			memcpy(spot, text, amount);
+
+			while ((spot = memchr(spot, '\n', batch + filled + amount - spot)))
+				*(spot++) = '\0';
+
+			filled += amount;
+			text += amount;
+			remainder -= amount;
+
+			if (filled == BATCHSIZE) {
+				okay = (fwrite(batch, 1, filled, stream) == filled);
+				filled = 0;
+			}
+		}
+
+		/* If we've reached the last line of the buffer, don't write a newline
+		 * character after it.  If this last line is empty, it means zero bytes
+		 * are written for it, and we don't count it in the number of lines. */
+		if (!okay || line->next == NULL) {
+			if (okay && line->data[0])
+				(*count)++;
+			break;
+		}
+
+		if (filled + 2 > BATCHSIZE) {
+			okay = (fwrite(batch, 1, filled, stream) == filled);
+			filled = 0;
+		}
+
+		/* Add the newline (preceded with a carriage return for a DOS file). */
+#ifndef NANO_TINY
+		if (openfile->fmt == DOS_FILE)
+			batch[filled++] = '\r';
+#endif
+		batch[filled++] = '\n';
+
+		line = line->next;
+		(*count)++;
+	}
+
+	if (okay && filled > 0)
+		okay = (fwrite(batch, 1, filled, stream) == filled);
+
+	/* Preserve the reason for a failure across the freeing. */
+	errnumber = errno;
+	free(batch);
+	errno = errnumber;
+
+	return okay;
+}
+
+#ifndef NANO_TINY
+/* Let a child process write the current buffer to the given stream, from
+ * the copy-on-write snapshot of memory that fork() gives it, so that the
+ * user can go on editing.  Return FALSE when no child could be started. */
+static bool save_in_background(FILE *stream)
+{
+#if defined(HAVE_FORK) && defined(HAVE_PIPE)
+	int tidings[2];
+	pid_t child;
+
+	if (pipe(tidings) < 0)
+		return FALSE;
+
+	if ((child = fork()) == 0) {
+		const int stoppers[] = { SIGTERM, SIGTSTP, SIGCONT, SIGSEGV, SIGBUS, SIGABRT };
+		struct sigaction deed = {{0}};
+		size_t lineswritten = 0;
+		int errnumber = 0;
+
+		/* Drop the handlers that would have the child act as nano, and
+		 * let the saving continue when the terminal goes away. */
+		deed.sa_handler = SIG_DFL;
+		for (int index = 0; index < 6; index++)
+			sigaction(stoppers[index], &deed, NULL);
+		deed.sa_handler = SIG_IGN;
+		sigaction(SIGHUP, &deed, NULL);
+		sigaction(SIGWINCH, &deed, NULL);
+
+		close(tidings[0]);
+
+		if (!write_lines(stream, openfile->filetop, &lineswritten) ||
+						fflush(stream) == EOF || fsync(fileno(stream)) < 0 ||
+						fclose(stream) == EOF)
+			errnumber = (errno != 0) ? errno : EIO;
+
+		IGNORE_CALL_RESULT(write(tidings[1], &lineswritten, sizeof(lineswritten)));
+		IGNORE_CALL_RESULT(write(tidings[1], &errnumber, sizeof(errnumber)));
+		_exit(0);
+	}
+
+	close(tidings[1]);
+
+	if (child < 0) {
+		close(tidings[0]);
+		return FALSE;
+	}
+
+	/* Nothing was written through our copy of the stream, so just close it. */
+	fclose(stream);
+
+	openfile->saver = child;
+	openfile->tidings = tidings[0];
+	openfile->snapshot = openfile->current_undo;
+	openfile->last_action = OTHER;
+
+	statusbar(_("Writing in the background..."));
+
+	return TRUE;
+#else
+	return FALSE;
+#endif
+}
+
+/* When the background save of the given buffer has ended (or, when wait is
+ * TRUE, after waiting for it to end), report how it went, and when it went
+ * well, mark the buffer as saved at the point where the snapshot was taken. */
+void collect_the_save(openfilestruct *buffer, bool wait)
+{
+	size_t lineswritten = 0;
+	int errnumber = EIO;
+
+	if (waitpid(buffer->saver, NULL, wait ? 0 : WNOHANG) == 0)
+		return;
+
+	/* When the child did not report (because it crashed), assume failure. */
+	if (read(buffer->tidings, &lineswritten, sizeof(lineswritten)) < (ssize_t)sizeof(lineswritten) ||
+				read(buffer->tidings, &errnumber, sizeof(errnumber)) < (ssize_t)sizeof(errnumber))
+		errnumber = EIO;
+
+	close(buffer->tidings);
+	buffer->saver = 0;
+
+	if (errnumber != 0) {
+		statusline(ALERT, _("Error writing %s: %s"), buffer->filename, strerror(errnumber));
+		if (errnumber == ENOSPC) {
+			napms(3200); lastmessage = VACUUM;
+			statusline(ALERT, _("File on disk has been truncated!"));
+			napms(3200); lastmessage = VACUUM;
+			statusline(ALERT, _("Maybe ^T^Z, make room on disk, resume, then ^S^X"));
+			stat_with_alloc(buffer->filename, &buffer->statinfo);
+		}
+		return;
+	}
+
+	stat_with_alloc(buffer->filename, &buffer->statinfo);
+
+	buffer->last_saved = buffer->snapshot;
+
+	/* When nothing was changed meanwhile, the buffer is no longer modified. */
+	if (buffer->current_undo == buffer->snapshot) {
+		buffer->modified = FALSE;
+		if (buffer == openfile)
+			titlebar(NULL);
+	}
+
+	statusline(REMARK, P_("Wrote %zu line", "Wrote %zu lines", lineswritten), lineswritten);
+}
+
+/* Report on any background saves that have ended.  Return TRUE when one
+ * or more of them are still going on. */
+bool saving_in_background(void)
+{
+	openfilestruct *buffer = openfile;
+	bool ongoing = FALSE;
+
+	do {
+		if (buffer->saver) {
+			collect_the_save(buffer, FALSE);
+			ongoing |= (buffer->saver != 0);
+		}
+#ifdef ENABLE_MULTIBUFFER
+		buffer = buffer->next;
+#endif
+	} while (buffer != openfile);
+
+	return ongoing;
+}
+#endif
+
 /* Write the current buffer to disk.  If `thefile` isn't NULL, it is
  * an already-open temporary file.  If `method` is APPEND or PREPEND,
  * append or prepend to the given file, instead of overwriting it.
@@ -1832,48 +2348,23 @@ bool write_file(const char *name, FILE *thefile, writing_type method, bool annot
 		}
 	}
 
-	if (normal)
-		statusbar(_("Writing..."));
-
-	while (TRUE) {
-		size_t data_len, wrote;
-
-		/* Decode LFs as the NULs that they are, before writing to disk. */
-		data_len = recode_LF_to_NUL(line->data);
-
-		wrote = fwrite(line->data, 1, data_len, thefile);
-
-		/* Re-encode any embedded NULs as LFs. */
-		recode_NUL_to_LF(line->data, data_len);
-
-		if (wrote < data_len) {
-			statusline(ALERT, _("Error writing %s: %s"), realname, strerror(errno));
-			fclose(thefile);
-			goto cleanup_and_exit;
-		}
-
-		/* If we've reached the last line of the buffer, don't write a newline
-		 * character after it.  If this last line is empty, it means zero bytes
-		 * are written for it, and we don't count it in the number of lines. */
-		if (line->next == NULL) {
-			if (line->data[0])
-				lineswritten++;
-			break;
-		}
-
-		/* Write the newline (preceded with a carriage return for a DOS file). */
-		if (
 #ifndef NANO_TINY
-			(openfile->fmt == DOS_FILE && putc('\r', thefile) == EOF) ||
+	/* When asked for, save a big buffer under its own name in the background. */
+	if (ISSET(BACKGROUND_SAVE) && annotate && method == OVERWRITE &&
+				openfile->totsize >= BACKGROUND_SIZE && !(is_existing_file && S_ISFIFO(fileinfo.st_mode)) &&
+				strcmp(openfile->filename, realname) == 0 && save_in_background(thefile)) {
+		free(realname);
+		return TRUE;
+	}
 #endif
-											putc('\n', thefile) == EOF) {
-			statusline(ALERT, _("Error writing %s: %s"), realname, strerror(errno));
-			fclose(thefile);
-			goto cleanup_and_exit;
-		}
 
-		line = line->next;
-		lineswritten++;
+	if (normal)
+		statusbar(_("Writing..."));
+
+	if (!write_lines(thefile, line, &lineswritten)) {
+		statusline(ALERT, _("Error writing %s: %s"), realname, strerror(errno));
+		fclose(thefile);
+		goto cleanup_and_exit;
 	}
 
 #ifndef NANO_TINY
@@ -1968,7 +2459,7 @@ bool write_file(const char *name, FILE *thefile, writing_type method, bool annot
 
 		/* Record at which point in the undo stack the buffer was saved. */
 		openfile->last_saved = openfile->current_undo;
-		openfile->last_action = OTHER;
+			openfile->last_action = OTHER;
 #endif
 		openfile->modified = FALSE;
 		titlebar(NULL);
@@ -2047,6 +2538,12 @@ int write_it_out(bool exiting, bool withprompt)
 	static bool did_credits = FALSE;
 #endif
 
+#ifndef NANO_TINY
+	/* First let an earlier save of this buffer complete. */
+	if (openfile->saver)
+		collect_the_save(openfile, TRUE);
+#endif
+
 	/* Display newlines in filenames as ^J. */
 	as_an_at = FALSE;
 
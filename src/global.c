@@ -73,6 +73,9 @@ char *title = NULL;
 bool refresh_needed = FALSE;
 		/* Did a command mangle enough of the buffer that we should
 		 * repaint the screen? */
+size_t edit_count = 0;
+		/* How many edits have been made (in any buffer) -- for knowing
+		 * whether cached info about the text is still valid. */
 bool united_sidescroll = TRUE;
 		/* Whether to scroll all lines sideways.  That is: whether to pan. */
 bool focusing = TRUE;
@@ -200,6 +203,10 @@ ssize_t tabsize = -1;
 #ifndef NANO_TINY
 char *backup_dir = NULL;
 		/* The directory where we store backup files. */
+ssize_t undo_limit = 0;
+		/* The number of megabytes that the undo data of a buffer may take
+		 * in memory before the oldest items get moved to disk; zero means
+		 * no limit. */
 #endif
 #ifdef ENABLE_OPERATINGDIR
 char *operating_dir = NULL;
@@ -230,6 +237,10 @@ int currmenu = MMOST;
 		/* The currently active menu, initialized to a dummy value. */
 keystruct *sclist = NULL;
 		/* The start of the shortcuts list. */
+static keytable *keytables = NULL;
+		/* The lookup tables made from the shortcuts list, one per menu. */
+static keytable *recent_table = NULL;
+		/* The lookup table that was used last. */
 funcstruct *allfuncs = NULL;
 		/* The start of the functions list. */
 funcstruct *tailfunc;
@@ -259,6 +270,9 @@ linestruct *executebot = NULL;
 
 regex_t search_regexp;
 		/* The compiled regular expression to use in searches. */
+unsigned char *search_leaders = NULL;
+		/* A bitmap of the bytes that can begin a match of that regex,
+		 * or NULL when any byte can, or when it can match emptiness. */
 regmatch_t regmatches[10];
 		/* The match positions for parenthetical subexpressions, 10
 		 * maximum, used in regular expression searches. */
@@ -427,6 +441,20 @@ void show_curses_version(void)
 }
 #endif
 
+/* Discard the lookup tables, because the list of shortcuts has changed. */
+void drop_the_keytables(void)
+{
+	while (keytables != NULL) {
+		keytable *next = keytables->next;
+
+		free(keytables->hashed);
+		free(keytables);
+		keytables = next;
+	}
+
+	recent_table = NULL;
+}
+
 /* Add a key combo to the linked list of shortcuts. */
 void add_to_sclist(int menus, const char *scstring, const int keycode,
 						void (*function)(void), int toggle)
@@ -457,6 +485,8 @@ void add_to_sclist(int menus, const char *scstring, const int keycode,
 	sc->keycode = (keycode ? keycode : keycode_from_string(scstring));
 
 	tailsc = sc;
+
+	drop_the_keytables();
 }
 
 /* Return the first shortcut in the list of shortcuts that
@@ -490,6 +520,60 @@ size_t shown_entries_for(int menu)
 	return count;
 }
 
+/* Build a table for quickly finding the shortcut that a keycode is bound to
+ * in the given menu(s) -- for each keycode the first such shortcut in the list,
+ * as that is the one that a walk through the list would find. */
+keytable *make_keytable(int menus)
+{
+	keytable *table = nmalloc(sizeof(keytable));
+	size_t higher = 0;
+
+	table->menus = menus;
+	table->hashed = NULL;
+	table->hashsize = 0;
+
+	for (int code = 0; code < DIRECT_KEYCODES; code++)
+		table->direct[code] = NULL;
+
+	for (keystruct *sc = sclist; sc != NULL; sc = sc->next)
+		if ((sc->menus & menus) && (sc->keycode < 0 || sc->keycode >= DIRECT_KEYCODES))
+			higher++;
+
+	/* Keep the hash table at most half full. */
+	if (higher > 0) {
+		table->hashsize = 8;
+		while (table->hashsize < 2 * higher)
+			table->hashsize *= 2;
+
+		table->hashed = nmalloc(table->hashsize * sizeof(keystruct *));
+		for (size_t slot = 0; slot < table->hashsize; slot++)
+			table->hashed[slot] = NULL;
+	}
+
+	for (keystruct *sc = sclist; sc != NULL; sc = sc->next) {
+		if (!(sc->menus & menus))
+			continue;
+
+		if (0 <= sc->keycode && sc->keycode < DIRECT_KEYCODES) {
+			if (table->direct[sc->keycode] == NULL)
+				table->direct[sc->keycode] = sc;
+		} else {
+			size_t slot = (unsigned int)sc->keycode & (table->hashsize - 1);
+
+			while (table->hashed[slot] && table->hashed[slot]->keycode != sc->keycode)
+				slot = (slot + 1) & (table->hashsize - 1);
+
+			if (table->hashed[slot] == NULL)
+				table->hashed[slot] = sc;
+		}
+	}
+
+	table->next = keytables;
+	keytables = table;
+
+	return table;
+}
+
 /* Return the first shortcut in the current menu that matches the given input. */
 const keystruct *get_shortcut(const int keycode)
 {
@@ -506,9 +590,28 @@ const keystruct *get_shortcut(const int keycode)
 		return planted_shortcut;
 #endif
 
-	for (keystruct *sc = sclist; sc != NULL; sc = sc->next) {
-		if ((sc->menus & currmenu) && keycode == sc->keycode)
-			return sc;
+	/* Find the table for the current menu, and make one when needed. */
+	if (recent_table == NULL || recent_table->menus != currmenu) {
+		for (recent_table = keytables; recent_table != NULL; recent_table = recent_table->next)
+			if (recent_table->menus == currmenu)
+				break;
+
+		if (recent_table == NULL)
+			recent_table = make_keytable(currmenu);
+	}
+
+	if (0 <= keycode && keycode < DIRECT_KEYCODES)
+		return recent_table->direct[keycode];
+
+	if (recent_table->hashsize > 0) {
+		const keystruct **hashed = recent_table->hashed;
+		size_t slot = (unsigned int)keycode & (recent_table->hashsize - 1);
+
+		while (hashed[slot]) {
+			if (hashed[slot]->keycode == keycode)
+				return hashed[slot];
+			slot = (slot + 1) & (recent_table->hashsize - 1);
+		}
 	}
 
 	return NULL;
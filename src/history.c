@@ -121,7 +121,7 @@ void update_history(linestruct **item, const char *text, bool avoid_duplicates)
 		thesame->next->prev = thesame->prev;
 
 		free(thesame->data);
-		free(thesame);
+		recycle_node(thesame);
 		(*hbot)->lineno--;
 	}
 
@@ -130,7 +130,7 @@ void update_history(linestruct **item, const char *text, bool avoid_duplicates)
 	if ((*hbot)->lineno > MAX_SEARCH_HISTORY) {
 		*htop = (*htop)->next;
 		free((*htop)->prev->data);
-		free((*htop)->prev);
+		recycle_node((*htop)->prev);
 		(*htop)->prev = NULL;
 		(*hbot)->lineno--;
 	}
@@ -63,10 +63,149 @@ static struct termios original_state;
 static struct sigaction oldaction, newaction;
 		/* Containers for the original and the temporary handler for SIGINT. */
 
+/* The number of line nodes that get allocated in one go. */
+#define NODES_PER_BATCH  1024
+
+static batchstruct **batches = NULL;
+		/* All batches of line nodes, in the order of their addresses. */
+static size_t batch_count = 0;
+		/* The number of batches in the above array. */
+static size_t batch_room = 0;
+		/* For how many batches there is space in the array. */
+static batchstruct *roomy = NULL;
+		/* The batches that have unused nodes, doubly linked. */
+static unsigned int last_version = 0;
+		/* The version number that was handed out most recently. */
+
+/* Add the given batch to the list of batches that have unused nodes. */
+static void list_as_roomy(batchstruct *batch)
+{
+	batch->prev = NULL;
+	batch->next = roomy;
+	if (roomy)
+		roomy->prev = batch;
+	roomy = batch;
+}
+
+/* Remove the given batch from the list of batches that have unused nodes. */
+static void unlist_as_roomy(batchstruct *batch)
+{
+	if (batch->prev)
+		batch->prev->next = batch->next;
+	else
+		roomy = batch->next;
+	if (batch->next)
+		batch->next->prev = batch->prev;
+}
+
+/* Return the index of the last batch that starts at or before the given node
+ * (or where a batch at that address would have to be inserted, minus one). */
+static size_t batch_index_for(const linestruct *node)
+{
+	size_t low = 0, high = batch_count;
+
+	while (high - low > 1) {
+		size_t middle = (low + high) / 2;
+
+		if (batches[middle]->nodes <= node)
+			low = middle;
+		else
+			high = middle;
+	}
+
+	return low;
+}
+
+/* Return an unused node, first allocating a new batch of nodes when none
+ * are left.  Carving the nodes out of big batches saves a malloc() per line
+ * and keeps consecutive lines of a freshly read file close together. */
+static linestruct *fresh_node(void)
+{
+	batchstruct *batch = roomy;
+	linestruct *node;
+
+	if (batch == NULL) {
+		size_t place = 0;
+
+		batch = nmalloc(sizeof(batchstruct));
+		batch->nodes = nmalloc(NODES_PER_BATCH * sizeof(linestruct));
+		batch->spare = NULL;
+		batch->in_use = 0;
+
+		for (int index = NODES_PER_BATCH - 1; index >= 0; index--) {
+			batch->nodes[index].next = batch->spare;
+			batch->spare = &batch->nodes[index];
+		}
+
+		if (batch_count == batch_room) {
+			batch_room = (batch_room == 0) ? 16 : 2 * batch_room;
+			batches = nrealloc(batches, batch_room * sizeof(batchstruct *));
+		}
+
+		/* Keep the array of batches ordered, so that it can be bisected. */
+		if (batch_count > 0) {
+			place = batch_index_for(batch->nodes);
+			if (batches[place]->nodes < batch->nodes)
+				place++;
+		}
+
+		memmove(batches + place + 1, batches + place,
+							(batch_count - place) * sizeof(batchstruct *));
+		batches[place] = batch;
+		batch_count++;
+
+		list_as_roomy(batch);
+	}
+
+	node = batch->spare;
+	batch->spare = node->next;
+	batch->in_use++;
+
+	if (batch->spare == NULL)
+		unlist_as_roomy(batch);
+
+	return node;
+}
+
+/* Give the given node (whose contents have been freed) back to its batch.
+ * When this leaves the batch unused, and other batches have room, free it. */
+void recycle_node(linestruct *line)
+{
+	size_t place = batch_index_for(line);
+	batchstruct *batch = batches[place];
+
+	if (batch->spare == NULL)
+		list_as_roomy(batch);
+
+	line->next = batch->spare;
+	batch->spare = line;
+
+	if (--batch->in_use > 0 || (batch == roomy && batch->next == NULL))
+		return;
+
+	unlist_as_roomy(batch);
+
+	memmove(batches + place, batches + place + 1,
+						(batch_count - place - 1) * sizeof(batchstruct *));
+	batch_count--;
+
+	free(batch->nodes);
+	free(batch);
+}
+
+/* Give the given line a new version number, because its text was changed
+ * in place, so that nothing derived from the old text will be used. */
+void mark_as_changed(linestruct *line)
+{
+	line->version = ++last_version;
+
+	upset_the_tallies(line->lineno, line->lineno);
+}
+
 /* Create a new linestruct node.  Note that we do not set prevnode->next. */
 linestruct *make_new_node(linestruct *prevnode)
 {
-	linestruct *newnode = nmalloc(sizeof(linestruct));
+	linestruct *newnode = fresh_node();
 
 	newnode->prev = prevnode;
 	newnode->next = NULL;
@@ -75,9 +214,11 @@ linestruct *make_new_node(linestruct *prevnode)
 	newnode->multidata = NULL;
 #endif
 	newnode->lineno = (prevnode) ? prevnode->lineno + 1 : 1;
+	newnode->is_milestone = FALSE;
 #ifndef NANO_TINY
 	newnode->has_anchor = FALSE;
 #endif
+	newnode->version = ++last_version;
 
 	return newnode;
 }
@@ -107,11 +248,21 @@ void delete_node(linestruct *line)
 	if (line == openfile->spillage_line)
 		openfile->spillage_line = NULL;
 #endif
+	/* If the first outdated line gets deleted, let the next take its place. */
+	if (line == openfile->renumber_point)
+		openfile->renumber_point = line->next;
+
+	/* A line that leaves the buffer can no longer serve as a milestone. */
+	if (line->is_milestone)
+		drop_milestones(line, line);
+
+	forget_the_cache_of(line);
+
 	free(line->data);
 #ifdef ENABLE_COLOR
 	free(line->multidata);
 #endif
-	free(line);
+	recycle_node(line);
 }
 
 /* Disconnect a node from a linked list of linestructs and delete it. */
@@ -146,16 +297,18 @@ void free_lines(linestruct *src)
 /* Make a copy of a linestruct node. */
 linestruct *copy_node(const linestruct *src)
 {
-	linestruct *dst = nmalloc(sizeof(linestruct));
+	linestruct *dst = fresh_node();
 
 	dst->data = copy_of(src->data);
 #ifdef ENABLE_COLOR
 	dst->multidata = NULL;
 #endif
 	dst->lineno = src->lineno;
+	dst->is_milestone = FALSE;
 #ifndef NANO_TINY
 	dst->has_anchor = src->has_anchor;
 #endif
+	dst->version = ++last_version;
 
 	return dst;
 }
@@ -184,15 +337,182 @@ linestruct *copy_buffer(const linestruct *src)
 	return head;
 }
 
-/* Renumber the lines in a buffer, from the given line onwards. */
-void renumber_from(linestruct *line)
+/* The number of sets in the cache of information derived from line texts,
+ * and the number of lines that each set can hold. */
+#define CACHE_SETS  256
+#define CACHE_WAYS  4
+
+static cachestruct *linecache = NULL;
+		/* What was derived from the texts of recently drawn lines. */
+static size_t cache_clock = 0;
+		/* The number of lookups in the above cache, to find the oldest entry. */
+static const linestruct *hinted_line = NULL;
+		/* Besides the current line, the line whose text is being measured. */
+
+/* Free the information in the given cache entry, and mark it as unused. */
+static void empty_the_entry(cachestruct *entry)
+{
+#ifdef ENABLE_COLOR
+	free(entry->paint);
+	entry->paint = NULL;
+#endif
+#ifndef NANO_TINY
+	free(entry->chunks);
+	entry->chunks = NULL;
+#endif
+	if (entry->checks) {
+		free(entry->checks->x);
+		free(entry->checks->column);
+		free(entry->checks);
+		entry->checks = NULL;
+	}
+	entry->line = NULL;
+}
+
+/* Return the set of cache entries in which the given line can be stored. */
+static cachestruct *cache_set_for(const linestruct *line)
+{
+	return linecache + CACHE_WAYS * (((size_t)line / sizeof(linestruct)) % CACHE_SETS);
+}
+
+/* Return the cache entry for the given line.  When the line has none,
+ * take the least recently used entry of its set and empty it.  Keeping this
+ * information outside of the nodes means that only a limited number of lines
+ * has it, and that the nodes themselves stay small. */
+cachestruct *cache_for(const linestruct *line)
+{
+	cachestruct *set, *oldest;
+
+	if (linecache == NULL) {
+		linecache = nmalloc(CACHE_SETS * CACHE_WAYS * sizeof(cachestruct));
+		memset(linecache, 0, CACHE_SETS * CACHE_WAYS * sizeof(cachestruct));
+	}
+
+	set = cache_set_for(line);
+	oldest = set;
+
+	for (int way = 0; way < CACHE_WAYS; way++) {
+		if (set[way].line == line) {
+			set[way].used = ++cache_clock;
+			return &set[way];
+		}
+		if (set[way].used < oldest->used)
+			oldest = &set[way];
+	}
+
+	empty_the_entry(oldest);
+
+	oldest->line = line;
+	oldest->used = ++cache_clock;
+
+	return oldest;
+}
+
+/* Discard whatever was cached about the given line. */
+void forget_the_cache_of(const linestruct *line)
+{
+	cachestruct *set;
+
+	if (line == hinted_line)
+		hinted_line = NULL;
+
+	if (linecache == NULL)
+		return;
+
+	set = cache_set_for(line);
+
+	for (int way = 0; way < CACHE_WAYS; way++)
+		if (set[way].line == line)
+			empty_the_entry(&set[way]);
+}
+
+/* Note that the text of the given line is about to be measured, so that
+ * checkpoints may be set for it when it is long. */
+void hint_the_line(const linestruct *line)
+{
+	hinted_line = line;
+}
+
+/* Return the current line or the hinted line when the given text is theirs,
+ * and NULL otherwise. */
+const linestruct *owner_of(const char *text)
+{
+	if (openfile && text == openfile->current->data)
+		return openfile->current;
+	else if (hinted_line && text == hinted_line->data)
+		return hinted_line;
+	else
+		return NULL;
+}
+
+#ifdef ENABLE_COLOR
+/* Free all cached regex matches, as they will not be needed for a while. */
+void forget_the_paint(void)
 {
-	ssize_t number = (line->prev == NULL) ? 0 : line->prev->lineno;
+	if (linecache == NULL)
+		return;
+
+	for (int index = 0; index < CACHE_SETS * CACHE_WAYS; index++) {
+		free(linecache[index].paint);
+		linecache[index].paint = NULL;
+	}
+}
+#endif
+
+/* Renumber at most the given number of outdated lines in the current buffer. */
+void continue_renumbering(size_t howmany)
+{
+	linestruct *line = openfile->renumber_point;
+	ssize_t number;
+
+	if (line == NULL)
+		return;
+
+	number = (line->prev == NULL) ? 0 : line->prev->lineno;
 
-	while (line) {
+	while (line && howmany-- > 0) {
 		line->lineno = ++number;
 		line = line->next;
 	}
+
+	openfile->renumber_point = line;
+}
+
+/* Bring the numbers of all lines in the current buffer up to date. */
+void finish_renumbering(void)
+{
+	continue_renumbering(HIGHEST_POSITIVE);
+}
+
+/* Renumber the lines from the given line through the given last line, which
+ * are the lines that were added or changed, and the lines after those, which
+ * merely shifted.  Only the changed lines plus a screenful are done right away,
+ * and the last line of the buffer; the rest are done while waiting for the
+ * next keystroke, or else just before the next command gets executed. */
+void renumber_lazily_from(linestruct *line, const linestruct *last)
+{
+	bool beyond = FALSE;
+	ssize_t before, number;
+	int count = 0;
+
+	finish_renumbering();
+
+	before = number = (line->prev == NULL) ? 0 : line->prev->lineno;
+
+	while (line && (!beyond || count++ < editwinrows)) {
+		line->lineno = ++number;
+		beyond |= (line == last);
+		line = line->next;
+	}
+
+	/* As all further lines shifted by the same amount, adjust the last line. */
+	if (line) {
+		openfile->filebot->lineno += number + 1 - line->lineno;
+		openfile->renumber_point = line;
+	}
+
+	/* The lines from the first through the last were added or changed. */
+	upset_the_tallies(before, last->lineno);
 }
 
 /* Display a warning about a key disabled in view mode. */
@@ -301,6 +621,12 @@ void do_exit(void)
 {
 	int choice;
 
+#ifndef NANO_TINY
+	/* Before deciding anything, let a save in the background complete. */
+	if (openfile->saver)
+		collect_the_save(openfile, TRUE);
+#endif
+
 	/* When unmodified, simply close.  Else, when doing automatic saving
 	 * and the file has a name, simply save.  Otherwise, ask the user. */
 	if (!openfile->modified || ISSET(VIEW_MODE))
@@ -426,6 +752,11 @@ void window_init(void)
 		footwin = newwin(bottomrows, COLS, LINES - bottomrows, 0);
 	}
 
+#ifndef NANO_TINY
+	/* The new edit window shows nothing yet. */
+	forget_the_rows();
+#endif
+
 	/* In case the terminal shrunk, make sure the status line is clear. */
 	wnoutrefresh(footwin);
 
@@ -937,12 +1268,13 @@ void set_up_signal_handlers(void)
 
 #if !defined(NANO_TINY) && !defined(DEBUG)
 	if (getenv("NANO_NOCATCH") == NULL) {
-		/* Trap SIGSEGV and SIGABRT to save any changed buffers and reset
-		 * the terminal to a usable state.  Reset these handlers to their
+		/* Trap SIGSEGV, SIGBUS, and SIGABRT to save any changed buffers and
+		 * reset the terminal to a usable state.  Reset these handlers to their
 		 * defaults as soon as their signal fires. */
 		deed.sa_handler = handle_crash;
 		deed.sa_flags |= SA_RESETHAND;
 		sigaction(SIGSEGV, &deed, NULL);
+		sigaction(SIGBUS, &deed, NULL);
 		sigaction(SIGABRT, &deed, NULL);
 	}
 #endif
@@ -1064,6 +1396,7 @@ void regenerate_screen(void)
 
 	/* Only when fully initialized, redraw the contents of the subwindows. */
 	if (we_are_running) {
+		finish_renumbering();
 		ensure_firstcolumn_is_aligned();
 		draw_all_subwindows();
 	}
@@ -1112,6 +1445,8 @@ void toggle_this(int flag)
 			break;
 #ifdef ENABLE_COLOR
 		case NO_SYNTAX:
+			if (ISSET(NO_SYNTAX))
+				forget_the_paint();
 			precalc_multicolorinfo();
 			refresh_needed = TRUE;
 			break;
@@ -1497,6 +1832,7 @@ void inject(char *burst, size_t count)
 						thisline->data + openfile->current_x,
 						datalen - openfile->current_x + 1);
 	strncpy(thisline->data + openfile->current_x, burst, count);
+	mark_as_changed(thisline);
 
 #ifndef NANO_TINY
 	/* When the cursor is on the top row and not on the first chunk
@@ -1564,6 +1900,46 @@ void inject(char *burst, size_t count)
 		update_line(openfile->current, openfile->current_x);
 }
 
+#ifndef NANO_TINY
+/* Return TRUE when the given function (or, when NULL, the typing of text) can
+ * be done while the rest of a large file is still being read in: when it just
+ * moves around, or when it edits something that is not close to the end of
+ * what was read so far, as that is where the next lines will be added. */
+static bool allowed_while_loading(functionptrtype function)
+{
+	if (function == do_up || function == do_down || function == do_left ||
+				function == do_right || function == do_home || function == do_end ||
+				function == do_page_up || function == do_page_down ||
+				function == to_prev_word || function == to_next_word ||
+				function == to_prev_block || function == to_next_block ||
+				function == to_top_row || function == to_bottom_row ||
+				function == to_first_line || function == do_scroll_up ||
+				function == do_scroll_down || function == do_scroll_left ||
+				function == do_scroll_right || function == do_center ||
+				function == do_cycle || function == do_mark || function == do_toggle ||
+				function == full_refresh ||
+				function == do_search_forward || function == do_search_backward ||
+				function == do_findnext || function == do_findprevious ||
+				function == do_gotolinecolumn || function == do_undo || function == do_redo)
+		return TRUE;
+#ifdef ENABLE_MULTIBUFFER
+	if (function == switch_to_prev_buffer || function == switch_to_next_buffer)
+		return TRUE;
+#endif
+	/* Leaving an unmodified buffer does not need the rest of its file. */
+	if (function == do_exit)
+		return !openfile->modified;
+
+	if (function == NULL || function == do_enter || function == do_tab ||
+				function == do_backspace || function == do_delete ||
+				function == cut_text || function == copy_text || function == paste_text)
+		return (!openfile->mark && openfile->current->next &&
+									openfile->current->next->next);
+
+	return FALSE;
+}
+#endif
+
 /* Read in a keystroke, and execute its command or insert it into the buffer. */
 void process_a_keystroke(void)
 {
@@ -1591,6 +1967,11 @@ void process_a_keystroke(void)
 	if (input == THE_WINDOW_RESIZED)
 		return;
 #endif
+	/* Unless the keystroke is a character for the buffer, first bring
+	 * all line numbers up to date, as the command might need them. */
+	if (input > 0xFF || input < 0x20 || meta_key)
+		finish_renumbering();
+
 #ifdef ENABLE_MOUSE
 	if (input == KEY_MOUSE) {
 		/* If the user clicked on a shortcut, read in the key code that it was
@@ -1634,6 +2015,14 @@ void process_a_keystroke(void)
 	/* If there are gathered bytes and we have a command or no other key codes
 	 * are waiting, it's time to insert these bytes into the edit buffer. */
 	if (depth > 0 && (function || waiting_keycodes() == 0)) {
+#ifndef NANO_TINY
+		/* Near the end of a file that is still being read in, first read
+		 * the rest; and if the user interrupts that, drop the typed text. */
+		if (openfile->mapping && !allowed_while_loading(NULL) && !finish_loading()) {
+			depth = 0;
+			return;
+		}
+#endif
 		puddle[depth] = '\0';
 		inject(puddle, depth);
 		depth = 0;
@@ -1662,6 +2051,12 @@ void process_a_keystroke(void)
 	} else if (meta_key)
 		give_a_hint = FALSE;
 
+#ifndef NANO_TINY
+	/* While a large file is still being read in, most commands need all of it. */
+	if (openfile->mapping && !allowed_while_loading(function) && !finish_loading())
+		return;
+#endif
+
 #ifdef ENABLE_NANORC
 	if (function == (functionptrtype)implant) {
 		implant(shortcut->expansion);
@@ -369,9 +369,8 @@ void draw_the_promptbar(void)
 	waddch(footwin, ':');
 	waddch(footwin, (the_page == 0) ? ' ' : '<');
 
-	expanded = display_string(answer, the_page, COLS - base, FALSE, TRUE);
+	expanded = display_scratch(answer, the_page, COLS - base, FALSE, TRUE);
 	waddstr(footwin, expanded);
-	free(expanded);
 
 	if (the_page < end_page && base + breadth(answer) - the_page > COLS)
 		mvwaddch(footwin, 0, COLS - 1, '>');
@@ -137,6 +137,7 @@ extern ssize_t tabsize;
 
 #ifndef NANO_TINY
 extern char *backup_dir;
+extern ssize_t undo_limit;
 #endif
 #ifdef ENABLE_OPERATINGDIR
 extern char *operating_dir;
@@ -156,6 +157,7 @@ extern bool recook;
 #endif
 
 extern bool refresh_needed;
+extern size_t edit_count;
 
 extern int currmenu;
 extern keystruct *sclist;
@@ -175,6 +177,7 @@ extern linestruct *executebot;
 #endif
 
 extern regex_t search_regexp;
+extern unsigned char *search_leaders;
 extern regmatch_t regmatches[10];
 
 extern int hilite_attribute;
@@ -221,6 +224,7 @@ bool is_doublewidth(const char *ch);
 bool is_zerowidth(const char *ch);
 #endif
 int char_length(const char *pointer);
+size_t ascii_run(const char *text, size_t most, bool printable);
 size_t mbstrlen(const char *pointer);
 int collect_char(const char *string, char *thechar);
 int advance_over(const char *string, size_t *column);
@@ -252,6 +256,7 @@ void set_interface_colorpairs(void);
 void prepare_palette(void);
 void find_and_prime_applicable_syntax(void);
 void check_the_multis(linestruct *line);
+void precalc_up_to(linestruct *lastline);
 void precalc_multicolorinfo(void);
 #endif
 
@@ -294,6 +299,11 @@ void switch_to_next_buffer(void);
 void close_buffer(void);
 #endif
 void read_file(FILE *f, int fd, const char *filename, bool undoable);
+#ifndef NANO_TINY
+void continue_loading(size_t howmany);
+bool load_up_to(ssize_t number);
+bool finish_loading(void);
+#endif
 int open_file(const char *filename, bool new_one, FILE **f);
 char *get_next_filename(const char *name, const char *suffix);
 void do_insertfile(void);
@@ -310,6 +320,10 @@ bool outside_of_confinement(const char *currpath, bool allow_tabcomp);
 void init_backup_dir(void);
 #endif
 int copy_file(FILE *inn, FILE *out, bool close_out);
+#ifndef NANO_TINY
+void collect_the_save(openfilestruct *buffer, bool wait);
+bool saving_in_background(void);
+#endif
 bool write_file(const char *name, FILE *thefile, writing_type method, bool annotate);
 #ifndef NANO_TINY
 bool write_region_to_file(const char *name, FILE *stream, writing_type method);
@@ -326,6 +340,7 @@ char *input_tab(char *buf, size_t *place, void (*refresh_func)(void), bool *list
 #endif
 
 /* Some functions in global.c. */
+void drop_the_keytables(void);
 const keystruct *first_sc_for(int menu, void (*function)(void));
 size_t shown_entries_for(int menu);
 const keystruct *get_shortcut(const int keycode);
@@ -398,13 +413,24 @@ void do_scroll_right(void);
 #endif
 
 /* Most functions in nano.c. */
+void recycle_node(linestruct *line);
+void mark_as_changed(linestruct *line);
 linestruct *make_new_node(linestruct *prevnode);
 void splice_node(linestruct *afterthis, linestruct *newnode);
 void unlink_node(linestruct *line);
 void delete_node(linestruct *line);
 linestruct *copy_buffer(const linestruct *src);
 void free_lines(linestruct *src);
-void renumber_from(linestruct *line);
+cachestruct *cache_for(const linestruct *line);
+void forget_the_cache_of(const linestruct *line);
+void hint_the_line(const linestruct *line);
+const linestruct *owner_of(const char *text);
+#ifdef ENABLE_COLOR
+void forget_the_paint(void);
+#endif
+void continue_renumbering(size_t howmany);
+void finish_renumbering(void);
+void renumber_lazily_from(linestruct *line, const linestruct *last);
 void print_view_warning(void);
 bool in_restricted_mode(void);
 #ifndef NANO_TINY
@@ -472,6 +498,7 @@ void do_rcfiles(void);
 #endif /* ENABLE_NANORC */
 
 /* Most functions in search.c. */
+unsigned char *leading_bytes(const char *regex, int rex_flags, bool with_empty);
 bool regexp_init(const char *regexp);
 void tidy_up_after_search(void);
 int findnextstr(const char *needle, bool whole_word_only, int modus,
@@ -481,6 +508,12 @@ void do_search_backward(void);
 void do_findprevious(void);
 void do_findnext(void);
 void not_found_msg(const char *str);
+#ifndef NANO_TINY
+const char *next_spot(const char *text, size_t index, size_t fullsize,
+		size_t limit, size_t *length);
+bool still_counting(void);
+void continue_counting(size_t howmany);
+#endif
 void go_looking(void);
 ssize_t do_replace_loop(const char *needle, bool whole_word_only,
 		const linestruct *real_current, size_t *real_current_x);
@@ -516,6 +549,7 @@ void do_redo(void);
 void do_enter(void);
 #ifndef NANO_TINY
 void discard_until(const undostruct *thisitem);
+bool page_in_undo_data(undostruct *item);
 void add_undo(undo_type action, const char *message);
 void update_multiline_undo(ssize_t lineno, char *indentation);
 void update_undo(undo_type action);
@@ -546,6 +580,8 @@ void do_linter(void);
 void do_formatter(void);
 #endif
 #ifndef NANO_TINY
+size_t number_of_words_in(const linestruct *topline, size_t top_x,
+		const linestruct *botline, size_t bot_x);
 void count_lines_words_and_characters(void);
 #endif
 void do_verbatim_input(void);
@@ -577,6 +613,7 @@ char *measured_copy(const char *string, size_t count);
 char *copy_of(const char *string);
 char *free_and_assign(char *dest, char *src);
 size_t get_page_start(size_t column);
+size_t nearest_checkpoint(const char *text, size_t limit, bool by_column, size_t *column);
 size_t actual_x(const char *text, size_t column);
 size_t wideness(const char *text, size_t count);
 size_t breadth(const char *text);
@@ -591,9 +628,11 @@ void get_region(linestruct **top, size_t *top_x, linestruct **bot, size_t *bot_x
 void get_range(linestruct **top, linestruct **bot);
 #endif
 size_t number_of_characters_in(const linestruct *begin, const linestruct *end);
-#if !defined(NANO_TINY) || defined(ENABLE_SPELLER) || defined (ENABLE_LINTER) || defined (ENABLE_FORMATTER)
+size_t characters_before(const linestruct *line);
+void upset_the_tallies(ssize_t after, ssize_t through);
+void drop_milestones(const linestruct *first, const linestruct *last);
+void discard_milestones(void);
 linestruct *line_from_number(ssize_t number);
-#endif
 
 /* Most functions in winio.c. */
 #ifndef NANO_TINY
@@ -619,6 +658,8 @@ void blank_it_when_expired(void);
 void set_blankdelay_to_one(void);
 char *display_string(const char *buf, size_t column, size_t span,
 						bool isdata, bool isprompt);
+char *display_scratch(const char *text, size_t column, size_t span,
+						bool isdata, bool isprompt);
 void titlebar(const char *path);
 void minibar(void);
 void statusline(message_type importance, const char *msg, ...);
@@ -635,10 +676,18 @@ bool line_needs_update(const size_t old_column, const size_t new_column);
 int go_back_chunks(int nrows, linestruct **line, size_t *leftedge);
 int go_forward_chunks(int nrows, linestruct **line, size_t *leftedge);
 bool less_than_a_screenful(size_t was_lineno, size_t was_leftedge);
+#ifndef NANO_TINY
+void forget_the_rows(void);
+void shift_the_rows(int amount);
+bool looks_the_same(void);
+void scroll_to_reuse_rows(void);
+int rows_still_showing(linestruct *line, int row);
+#endif
 void edit_scroll(bool direction);
 #ifndef NANO_TINY
 size_t get_softwrap_breakpoint(const char *linedata, size_t leftedge,
 								bool *kickoff, bool *end_of_line);
+const chunkstruct *chunks_of(linestruct *line);
 size_t get_chunk_and_edge(size_t column, linestruct *line, size_t *leftedge);
 size_t chunk_for(size_t column, linestruct *line);
 size_t leftedge_for(size_t column, linestruct *line);
@@ -96,6 +96,7 @@ static const rcoption rcopts[] = {
 	{"allow_insecure_backup", INSECURE_BACKUP},
 	{"atblanks", AT_BLANKS},
 	{"autoindent", AUTOINDENT},
+	{"backgroundsave", BACKGROUND_SAVE},
 	{"backup", MAKE_BACKUP},
 	{"backupdir", 0},
 	{"bookstyle", BOOKSTYLE},
@@ -110,6 +111,7 @@ static const rcoption rcopts[] = {
 	{"minibar", MINIBAR},
 	{"noconvert", NO_CONVERT},
 	{"showcursor", SHOW_CURSOR},
+	{"showmatches", SHOW_MATCHES},
 	{"smarthome", SMART_HOME},
 	{"softwrap", SOFTWRAP},
 	{"solosidescroll", SOLO_SIDESCROLL},
@@ -117,6 +119,7 @@ static const rcoption rcopts[] = {
 	{"tabsize", 0},
 	{"tabstospaces", TABS_TO_SPACES},
 	{"trimblanks", TRIM_BLANKS},
+	{"undolimit", 0},
 	{"unix", MAKE_IT_UNIX},
 	{"whitespace", 0},
 	{"whitespacedisplay", WHITESPACE_DISPLAY},
@@ -826,6 +829,9 @@ void parse_binding(char *ptr, bool dobind)
 		if ((s->menus & menu) && s->keycode == keycode)
 			s->menus &= ~menu;
 
+	/* Any tables made for looking up shortcuts are now outdated. */
+	drop_the_keytables();
+
 	/* When unbinding, we are done now. */
 	if (!dobind)
 		goto free_things;
@@ -1154,6 +1160,9 @@ bool parse_combination(char *combotext, short *fg, short *bg, int *attributes)
 void parse_rule(char *ptr, int rex_flags)
 {
 	char *names, *regexstring;
+#ifdef USE_POSIX_THREADS
+	char *startstring;
+#endif
 	short fg, bg;
 	int attributes;
 
@@ -1193,6 +1202,10 @@ void parse_rule(char *ptr, int rex_flags)
 		if (ptr == NULL || !compile(regexstring, rex_flags, &start_rgx))
 			return;
 
+#ifdef USE_POSIX_THREADS
+		startstring = regexstring;
+#endif
+
 		if (expectend) {
 			if (strncmp(ptr, "end=", 4) != 0) {
 				jot_error(N_("\"start=\" requires a corresponding \"end=\""));
@@ -1218,6 +1231,17 @@ void parse_rule(char *ptr, int rex_flags)
 		newcolor->start = start_rgx;
 		newcolor->end = end_rgx;
 
+		/* For a single-line rule, note with which bytes a match can begin. */
+		newcolor->leaders = (expectend) ? NULL : leading_bytes(regexstring, rex_flags, FALSE);
+
+#ifdef USE_POSIX_THREADS
+		/* For a multiline rule, keep the sources, so that the regexes can
+		 * be compiled again for each thread that precalculates its info. */
+		newcolor->start_text = (expectend) ? copy_of(startstring) : NULL;
+		newcolor->end_text = (expectend) ? copy_of(regexstring) : NULL;
+		newcolor->flags = rex_flags;
+#endif
+
 		newcolor->fg = fg;
 		newcolor->bg = bg;
 		newcolor->attributes = attributes;
@@ -1681,6 +1705,12 @@ void parse_rcfile(FILE *rcstream, bool just_syntax, bool intros_only)
 				jot_error(N_("Requested tab size \"%s\" is invalid"), argument);
 				tabsize = -1;
 			}
+		} else if (strcmp(option, "undolimit") == 0) {
+			if (!parse_num(argument, &undo_limit) || undo_limit < 0) {
+				jot_error(N_("Undo limit \"%s\" is invalid"), argument);
+				undo_limit = 0;
+			} else if (undo_limit > (ssize_t)(HIGHEST_POSITIVE >> 20))
+				undo_limit = HIGHEST_POSITIVE >> 20;
 		}
 #else
 		;  /* Properly terminate any earlier 'else'. */
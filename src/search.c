@@ -21,13 +21,311 @@
 
 #include "prototypes.h"
 
+#include <ctype.h>
+#ifdef USE_POSIX_THREADS
+#include <pthread.h>
+#endif
 #include <string.h>
 #include <time.h>
+#ifdef USE_POSIX_THREADS
+#include <unistd.h>
+#endif
+
+/* The number of lines to read in of a large file when a search reaches its end. */
+#define LINES_PER_SEARCH  20000
+
+#ifdef USE_POSIX_THREADS
+/* The most threads that will share a regex search. */
+#define MAX_SEEKERS  32
+/* The number of lines that a thread looks through in one go. */
+#define LINES_PER_BLOCK  2048
+/* The least number of lines ahead that makes it worth starting threads. */
+#define LINES_FOR_SEEKERS  100000
+#endif
 
 static bool came_full_circle = FALSE;
 		/* Have we reached the starting line again while searching? */
 static bool have_compiled_regexp = FALSE;
 		/* Whether we have compiled a regular expression for the search. */
+#ifndef NANO_TINY
+static char *spotted_needle = NULL;
+		/* The search string whose occurrences are counted and highlighted. */
+static bool spotted_as_regexp = FALSE;
+		/* Whether that string was sought as a regular expression. */
+static bool spotted_with_case = FALSE;
+		/* Whether that string was sought case-sensitively. */
+static size_t spotted_size = 0;
+		/* The length of that string in bytes. */
+static size_t spotted_chars = 0;
+		/* The length of that string in characters. */
+static regex_t spotting_regexp;
+		/* The compiled form of the spotted needle, when it is a regex. */
+static unsigned char *spotting_leaders = NULL;
+		/* The bytes that can begin a match of that regex, if known. */
+static const openfilestruct *counted_buffer = NULL;
+		/* The buffer in which the occurrences were counted last. */
+static size_t counted_stamp = 0;
+		/* The value of edit_count at the time of that counting. */
+static linestruct **counted_lines = NULL;
+		/* The lines that contain at least one occurrence, in order. */
+static size_t *counted_before = NULL;
+		/* For each of those lines, the number of occurrences before it. */
+static size_t counted_number = 0;
+		/* The number of lines with occurrences. */
+static size_t counted_total = 0;
+		/* The number of occurrences in the lines counted so far. */
+static linestruct *counting_line = NULL;
+		/* The next line to count in, or NULL when counting is complete. */
+static const linestruct *ranked_line = NULL;
+		/* The line of the occurrence whose rank was last reported. */
+static size_t ranked_x = 0;
+		/* The x position of that occurrence. */
+static size_t ranked_rank = 0;
+		/* The rank of that occurrence. */
+static bool ranked_wrapped = FALSE;
+		/* Whether the search wrapped around to get to it. */
+#endif
+
+#define ADD_BYTE(set, byte)  set[(unsigned char)(byte) >> 3] |= 1 << ((byte) & 7)
+
+/* Return TRUE when the given ASCII byte belongs to the character class with
+ * the given name, or when the name is unknown. */
+static bool in_class(const char *name, size_t length, int byte)
+{
+	const char *names[] = { "alpha", "digit", "alnum", "upper", "lower", "space",
+							"blank", "punct", "print", "graph", "cntrl", "xdigit" };
+	int (*testers[])(int) = { isalpha, isdigit, isalnum, isupper, islower, isspace,
+							isblank, ispunct, isprint, isgraph, iscntrl, isxdigit };
+
+	for (int index = 0; index < 12; index++)
+		if (strlen(names[index]) == length && strncmp(name, names[index], length) == 0)
+			return testers[index](byte);
+
+	return TRUE;
+}
+
+/* Add to the given set all the bytes that could begin a nonempty match of
+ * the bracket expression at ptr, and move ptr beyond it.  The set may be too
+ * wide, but never too narrow.  Return FALSE when any byte could match. */
+static bool scan_bracket(const char **ptr, unsigned char *set)
+{
+	const char *item = *ptr + 1;
+	bool negated = (*item == '^');
+	bool fine = !negated;
+
+	if (negated)
+		item++;
+
+	/* A closing bracket right after the opening one is literal. */
+	if (*item == ']') {
+		ADD_BYTE(set, ']');
+		item++;
+	}
+
+	while (*item != '\0' && *item != ']') {
+		if (*item == '[' && (item[1] == ':' || item[1] == '.' || item[1] == '=')) {
+			const char *close = strchr(item + 2, item[1]);
+
+			if (close == NULL || close[1] != ']')
+				return FALSE;
+
+			/* Take in the bytes of the class, plus all bytes that can begin
+			 * a multibyte character.  Collating elements mean anything. */
+			for (int byte = 1; byte < 256; byte++)
+				if (item[1] != ':' || byte > 127 || in_class(item + 2, close - item - 2, byte))
+					ADD_BYTE(set, byte);
+
+			item = close + 2;
+		} else if (item[1] == '-' && item[2] != ']' && item[2] != '\0') {
+			unsigned char low = item[0], high = item[2];
+
+			if (low > 127 || high > 127 || high == '[')
+				fine = FALSE;
+
+			/* Include both cases, in case ranges follow a collating order. */
+			for (int byte = low; byte <= high && fine; byte++) {
+				ADD_BYTE(set, byte);
+				ADD_BYTE(set, tolower(byte));
+				ADD_BYTE(set, toupper(byte));
+			}
+
+			item += 3;
+		} else {
+			const char *next = item + 1;
+
+			ADD_BYTE(set, *item);
+
+			/* Skip the continuation bytes of a multibyte character. */
+			while (using_utf8 && (unsigned char)*next >= 0x80 && (unsigned char)*next < 0xC0)
+				next++;
+
+			/* A range that starts with a multibyte character is not understood. */
+			if (next > item + 1 && *next == '-' && next[1] != ']' && next[1] != '\0')
+				fine = FALSE;
+
+			item = next;
+		}
+	}
+
+	*ptr = (*item == ']') ? item + 1 : item;
+
+	return fine;
+}
+
+/* Add to the given set all the bytes that could begin a nonempty match of the
+ * atom at ptr (which is not a group), move ptr beyond the atom, and set nullable
+ * when the atom can match the empty string.  Set anchor when it is an anchor. */
+static void scan_atom(const char **ptr, unsigned char *set, bool *nullable, bool *anchor)
+{
+	const char *regex = *ptr;
+	bool fine = TRUE;
+
+	*nullable = FALSE;
+	*anchor = FALSE;
+
+	if (*regex == '^' || *regex == '$' ||
+						(*regex == '\\' && regex[1] != '\0' && strchr("<>bB`'", regex[1]))) {
+		*nullable = TRUE;
+		*anchor = TRUE;
+		*ptr = regex + ((*regex == '\\') ? 2 : 1);
+		return;
+	} else if (*regex == '[')
+		fine = scan_bracket(ptr, set);
+	else if (*regex == '\\' && (regex[1] == 'w' || regex[1] == 's')) {
+		for (int byte = 1; byte < 256; byte++)
+			if (byte > 127 || (regex[1] == 'w' ? (isalnum(byte) || byte == '_') : isspace(byte)))
+				ADD_BYTE(set, byte);
+		*ptr = regex + 2;
+	} else if (*regex == '\\' && regex[1] != '\0') {
+		/* An escaped letter or digit is a class or a backreference. */
+		fine = !isalnum((unsigned char)regex[1]);
+		ADD_BYTE(set, regex[1]);
+		*ptr = regex + 2;
+	} else if (*regex != '\0' && !strchr(".*+?{|)", *regex)) {
+		ADD_BYTE(set, *regex);
+		regex++;
+		/* Skip the continuation bytes of a multibyte character. */
+		while (using_utf8 && (unsigned char)*regex >= 0x80 && (unsigned char)*regex < 0xC0)
+			regex++;
+		*ptr = regex;
+	} else {
+		fine = FALSE;
+		if (*regex != '\0')
+			*ptr = regex + 1;
+	}
+
+	/* For a dot or a negated bracket (or anything not understood),
+	 * any byte could begin a match. */
+	if (!fine)
+		memset(set, 0xFF, 32);
+}
+
+/* Add to the given set all the bytes that could begin a nonempty match of the
+ * alternation at ptr, up to a closing parenthesis or the end of the regex. */
+static void scan_alternation(const char **ptr, unsigned char *set, bool *nullable)
+{
+	bool still_empty = TRUE;
+
+	*nullable = FALSE;
+
+	while (**ptr != '\0' && **ptr != ')') {
+		unsigned char atomset[32] = "";
+		bool empty_atom, anchor;
+
+		if (**ptr == '|') {
+			*nullable |= still_empty;
+			still_empty = TRUE;
+			(*ptr)++;
+			continue;
+		}
+
+		/* A group is an alternation of its own. */
+		if (**ptr == '(') {
+			(*ptr)++;
+			scan_alternation(ptr, atomset, &empty_atom);
+			if (**ptr == ')')
+				(*ptr)++;
+			anchor = FALSE;
+		} else
+			scan_atom(ptr, atomset, &empty_atom, &anchor);
+
+		/* Look at any quantifiers that follow the atom.  When an anchor is
+		 * followed by one, or when a brace does not start an interval,
+		 * the regex is not understood well enough. */
+		while (**ptr == '*' || **ptr == '+' || **ptr == '?' || **ptr == '{') {
+			if (anchor || (**ptr == '{' && !isdigit((unsigned char)(*ptr)[1]) &&
+												(*ptr)[1] != ',')) {
+				memset(atomset, 0xFF, 32);
+				empty_atom = FALSE;
+			} else if (**ptr != '+' && (**ptr != '{' || (*ptr)[1] == '0' || (*ptr)[1] == ','))
+				empty_atom = TRUE;
+
+			if (**ptr == '{' && strchr(*ptr, '}'))
+				*ptr = strchr(*ptr, '}');
+			(*ptr)++;
+		}
+
+		/* Only atoms preceded by atoms that can be empty can begin a match. */
+		if (still_empty)
+			for (int index = 0; index < 32; index++)
+				set[index] |= atomset[index];
+
+		still_empty = still_empty && empty_atom;
+	}
+
+	*nullable |= still_empty;
+}
+
+/* Determine the set of bytes that can begin a nonempty match of the given
+ * extended regex, so that matching can be skipped for lines that contain
+ * none of these bytes.  Return NULL when any byte could begin a match, or
+ * (when also empty matches count) when the regex can match the empty string. */
+unsigned char *leading_bytes(const char *regex, int rex_flags, bool with_empty)
+{
+	unsigned char *set = nmalloc(32);
+	bool nullable, everything = TRUE;
+
+	memset(set, 0, 32);
+
+	scan_alternation(&regex, set, &nullable);
+
+	/* With a stray closing parenthesis, the analysis cannot be trusted. */
+	if (*regex != '\0')
+		memset(set, 0xFF, 32);
+
+	if (rex_flags & REG_ICASE) {
+		bool widen = FALSE, high = FALSE;
+
+		for (int byte = 'A'; byte <= 'z'; byte++)
+			if (set[byte >> 3] & (1 << (byte & 7))) {
+				ADD_BYTE(set, tolower(byte));
+				ADD_BYTE(set, toupper(byte));
+				widen |= isalpha(byte);
+			}
+		for (int byte = 128; byte < 256; byte++)
+			high |= (set[byte >> 3] & (1 << (byte & 7)));
+
+		/* As some multibyte characters fold to an ASCII letter (like the
+		 * Kelvin sign to "k"), a letter can also begin with a high byte,
+		 * and a multibyte character can match an ASCII letter. */
+		if (widen || high)
+			memset(set + 16, 0xFF, 16);
+		if (high)
+			for (int byte = 'A'; byte <= 'z'; byte++)
+				if (isalpha(byte))
+					ADD_BYTE(set, byte);
+	}
+
+	for (int index = 0; index < 32; index++)
+		everything = everything && ((set[index] | (index == 0)) == 0xFF);
+
+	if (everything || (with_empty && nullable)) {
+		free(set);
+		return NULL;
+	}
+
+	return set;
+}
 
 /* Compile the given regular expression and store it in search_regexp.
  * Return TRUE if the expression is valid, and FALSE otherwise. */
@@ -50,6 +348,9 @@ bool regexp_init(const char *regexp)
 
 	have_compiled_regexp = TRUE;
 
+	free(search_leaders);
+	search_leaders = leading_bytes(regexp, ISSET(CASE_SENSITIVE) ? 0 : REG_ICASE, TRUE);
+
 	return TRUE;
 }
 
@@ -60,6 +361,8 @@ void tidy_up_after_search(void)
 	if (have_compiled_regexp) {
 		regfree(&search_regexp);
 		have_compiled_regexp = FALSE;
+		free(search_leaders);
+		search_leaders = NULL;
 	}
 #ifndef NANO_TINY
 	if (openfile->mark)
@@ -127,9 +430,14 @@ void search_init(bool replacing, bool retain_answer)
 			if (ISSET(USE_REGEXP) && !regexp_init(last_search))
 				break;
 
-			if (replacing)
+			if (replacing) {
+#ifndef NANO_TINY
+				/* Replacing needs all of a file that is still being read in. */
+				if (openfile->mapping && !finish_loading())
+					break;
+#endif
 				ask_for_and_do_replacements();
-			else
+			} else
 				go_looking();
 
 			break;
@@ -166,6 +474,230 @@ void search_init(bool replacing, bool retain_answer)
 	free(thedefault);
 }
 
+/* Consume any queued-up keystrokes (in non-blocking mode), until a Cancel
+ * or nothing.  Return TRUE when a Cancel was found. */
+static bool cancel_was_typed(void)
+{
+	int input = wgetch(midwin);
+
+	while (input != ERR) {
+		if (input == ESC_CODE) {
+			napms(20);
+			input = wgetch(midwin);
+			meta_key = TRUE;
+		} else
+			meta_key = FALSE;
+
+		if (func_from_key(input) == do_cancel) {
+#ifndef NANO_TINY
+			if (the_window_resized)
+				regenerate_screen();
+#endif
+			/* Clear out the key buffer (in case a macro is running). */
+			while (input != ERR)
+				input = get_input(NULL);
+			return TRUE;
+		}
+
+		input = wgetch(midwin);
+	}
+
+	return FALSE;
+}
+
+#ifdef USE_POSIX_THREADS
+typedef struct seekerstruct {
+	pthread_t thread;
+		/* The identifier of this thread. */
+	const char *needle;
+		/* The regex that is sought. */
+	int *feedback;
+		/* For the current thread only: the state of the "Searching..." message. */
+} seekerstruct;
+
+static pthread_mutex_t seeklock = PTHREAD_MUTEX_INITIALIZER;
+		/* The lock that guards the variables below. */
+static const linestruct *seek_cursor;
+		/* The first line of the next block of lines that is up for grabs. */
+static const linestruct *seek_stopper;
+		/* The line where the handing out of blocks stops. */
+static size_t seek_blocks;
+		/* The number of blocks that have been handed out. */
+static size_t found_block;
+		/* The lowest number of a block in which a match was found. */
+static const linestruct *found_line;
+		/* The first line with a match in that block. */
+static bool seek_cancelled;
+		/* Whether the user cancelled the search. */
+
+/* Return TRUE when the given text contains a match for the given regex. */
+static bool has_a_match(regex_t *regex, const char *text)
+{
+	/* When no byte of the text can begin a match, skip running the regex. */
+	if (search_leaders) {
+		const char *spot = text;
+
+		while (*spot && !(search_leaders[(unsigned char)*spot >> 3] & (1 << (*spot & 7))))
+			spot++;
+
+		if (*spot == '\0')
+			return FALSE;
+	}
+
+	return (regexec(regex, text, 0, NULL, 0) == 0);
+}
+
+/* Take blocks of lines, in the direction of the search, and look in each line
+ * of a block for a match, until a match is found in an earlier block or no
+ * blocks are left.  The current thread also glances at the keyboard. */
+static void *seek_in_blocks(void *data)
+{
+	seekerstruct *seeker = data;
+	regex_t private, *regex = &search_regexp;
+	time_t lastkbcheck = time(NULL);
+
+	/* Threads that use the same compiled regex take turns, so use a copy. */
+	if (seeker->feedback == NULL && regcomp(&private, seeker->needle,
+				NANO_REG_EXTENDED | (ISSET(CASE_SENSITIVE) ? 0 : REG_ICASE)) == 0)
+		regex = &private;
+
+	while (TRUE) {
+		const linestruct *line, *stop;
+		size_t block;
+
+		pthread_mutex_lock(&seeklock);
+
+		if (seek_cursor == seek_stopper || seek_blocks >= found_block || seek_cancelled) {
+			pthread_mutex_unlock(&seeklock);
+			break;
+		}
+
+		block = seek_blocks++;
+		line = seek_cursor;
+
+		for (int count = 0; count < LINES_PER_BLOCK && seek_cursor != seek_stopper; count++)
+			seek_cursor = ISSET(BACKWARDS_SEARCH) ? seek_cursor->prev : seek_cursor->next;
+
+		stop = seek_cursor;
+
+		pthread_mutex_unlock(&seeklock);
+
+		for (; line != stop; line = ISSET(BACKWARDS_SEARCH) ? line->prev : line->next)
+			if (has_a_match(regex, line->data)) {
+				pthread_mutex_lock(&seeklock);
+				if (block < found_block) {
+					found_block = block;
+					found_line = line;
+				}
+				pthread_mutex_unlock(&seeklock);
+				break;
+			}
+
+		/* Once a second, let the current thread check for a Cancel. */
+		if (seeker->feedback && time(NULL) - lastkbcheck > 0) {
+			lastkbcheck = time(NULL);
+
+			if (cancel_was_typed()) {
+				pthread_mutex_lock(&seeklock);
+				seek_cancelled = TRUE;
+				pthread_mutex_unlock(&seeklock);
+				break;
+			}
+
+			if (++(*seeker->feedback) > 0)
+				statusbar(_("Searching..."));
+		}
+	}
+
+	if (regex == &private)
+		regfree(&private);
+
+	return NULL;
+}
+
+/* Starting at the given line, look in the direction of the search for the
+ * first line that contains a match for the given regex, but go no further
+ * than the line where the search began.  When the stretch of lines to look
+ * through is long, let several threads do the looking.  Return the line with
+ * the match, or else the line just before the end of the stretch, or NULL
+ * when the user cancelled. */
+static linestruct *first_line_with_match(linestruct *line, const linestruct *begin,
+										const char *needle, int *feedback)
+{
+	static long processors = 0;
+	bool backward = ISSET(BACKWARDS_SEARCH);
+	const linestruct *stopper = NULL;
+	seekerstruct seeker[MAX_SEEKERS];
+	sigset_t allsignals, oldmask;
+	long threads, started;
+	ssize_t distance;
+
+	/* When the starting line lies ahead, stop there, so that it is noticed. */
+	if (begin && (backward ? begin->lineno < line->lineno : begin->lineno > line->lineno))
+		stopper = begin;
+
+	if (backward)
+		distance = line->lineno - (stopper ? stopper->lineno : 0);
+	else
+		distance = (stopper ? stopper->lineno : openfile->filebot->lineno + 1) - line->lineno;
+
+	if (distance < LINES_FOR_SEEKERS)
+		return line;
+
+	if (processors == 0)
+		processors = sysconf(_SC_NPROCESSORS_ONLN);
+
+	if (processors < 2)
+		return line;
+
+	/* When a match is near, it is quicker to find it without any threads. */
+	for (int count = 0; count < LINES_PER_BLOCK; count++) {
+		if (has_a_match(&search_regexp, line->data))
+			return line;
+		line = backward ? line->prev : line->next;
+	}
+
+	threads = (processors > MAX_SEEKERS) ? MAX_SEEKERS : processors;
+
+	seek_cursor = line;
+	seek_stopper = stopper;
+	seek_blocks = 0;
+	found_block = (size_t)-1;
+	found_line = NULL;
+	seek_cancelled = FALSE;
+
+	/* Leave the handling of any signals to the current thread. */
+	sigfillset(&allsignals);
+	pthread_sigmask(SIG_SETMASK, &allsignals, &oldmask);
+
+	for (started = 1; started < threads; started++) {
+		seeker[started].needle = needle;
+		seeker[started].feedback = NULL;
+
+		if (pthread_create(&seeker[started].thread, NULL, seek_in_blocks, &seeker[started]) != 0)
+			break;
+	}
+
+	pthread_sigmask(SIG_SETMASK, &oldmask, NULL);
+
+	seeker[0].needle = needle;
+	seeker[0].feedback = feedback;
+	seek_in_blocks(&seeker[0]);
+
+	for (int index = 1; index < started; index++)
+		pthread_join(seeker[index].thread, NULL);
+
+	if (seek_cancelled)
+		return NULL;
+	else if (found_line)
+		return (linestruct *)found_line;
+	else if (stopper)
+		return backward ? stopper->next : stopper->prev;
+	else
+		return backward ? openfile->filetop : openfile->filebot;
+}
+#endif /* USE_POSIX_THREADS */
+
 /* Look for needle, starting at (current, current_x).  begin is the line
  * where we first started searching, at column begin_x.  Return 1 when we
  * found something, 0 when nothing, and -2 on cancel.  When match_len is
@@ -195,6 +727,15 @@ int findnextstr(const char *needle, bool whole_word_only, int modus,
 		came_full_circle = FALSE;
 
 	while (TRUE) {
+#ifndef NANO_TINY
+		/* When arriving at the end of what was read in of a large file,
+		 * first read some more of it, so that the search can go on. */
+		if (line == openfile->filebot && openfile->mapping && !ISSET(BACKWARDS_SEARCH)) {
+			continue_loading(LINES_PER_SEARCH);
+			titlebar(NULL);
+			from = line->data;
+		}
+#endif
 		/* When starting a new search, skip the first character, then
 		 * (in either case) search for the needle in the current line. */
 		if (skipone) {
@@ -243,6 +784,19 @@ int findnextstr(const char *needle, bool whole_word_only, int modus,
 		/* Move to the previous or next line in the file. */
 		line = (ISSET(BACKWARDS_SEARCH)) ? line->prev : line->next;
 
+#ifdef USE_POSIX_THREADS
+		/* For a regex, skip any lines without a match in one sweep. */
+		if (line && line != begin && ISSET(USE_REGEXP) && !whole_word_only) {
+			line = first_line_with_match(line, begin, needle, &feedback);
+
+			if (line == NULL) {
+				statusbar(_("Cancelled"));
+				nodelay(midwin, FALSE);
+				return -2;
+			}
+		}
+#endif
+
 		/* If we've reached the start or end of the buffer, wrap around;
 		 * but stop when spell-checking or replacing in a region. */
 		if (line == NULL) {
@@ -250,6 +804,13 @@ int findnextstr(const char *needle, bool whole_word_only, int modus,
 				nodelay(midwin, FALSE);
 				return 0;
 			}
+#ifndef NANO_TINY
+			/* Before wrapping backward, read in the rest of the file. */
+			if (openfile->mapping && !finish_loading()) {
+				nodelay(midwin, FALSE);
+				return -2;
+			}
+#endif
 
 			line = (ISSET(BACKWARDS_SEARCH)) ? openfile->filebot : openfile->filetop;
 
@@ -271,33 +832,12 @@ int findnextstr(const char *needle, bool whole_word_only, int modus,
 
 		/* Glance at the keyboard once every second, to check for a Cancel. */
 		if (time(NULL) - lastkbcheck > 0) {
-			int input = wgetch(midwin);
-
 			lastkbcheck = time(NULL);
 
-			/* Consume any queued-up keystrokes, until a Cancel or nothing. */
-			while (input != ERR) {
-				if (input == ESC_CODE) {
-					napms(20);
-					input = wgetch(midwin);
-					meta_key = TRUE;
-				} else
-					meta_key = FALSE;
-
-				if (func_from_key(input) == do_cancel) {
-#ifndef NANO_TINY
-					if (the_window_resized)
-						regenerate_screen();
-#endif
-					statusbar(_("Cancelled"));
-					/* Clear out the key buffer (in case a macro is running). */
-					while (input != ERR)
-						input = get_input(NULL);
-					nodelay(midwin, FALSE);
-					return -2;
-				}
-
-				input = wgetch(midwin);
+			if (cancel_was_typed()) {
+				statusbar(_("Cancelled"));
+				nodelay(midwin, FALSE);
+				return -2;
 			}
 
 			if (++feedback > 0)
@@ -417,6 +957,268 @@ void not_found_msg(const char *str)
 	free(disp);
 }
 
+#ifndef NANO_TINY
+/* Take the current search string (and the current way of matching it) as the
+ * one whose occurrences are counted and highlighted.  When it is a regular
+ * expression, compile it.  Return FALSE when this fails. */
+bool spot_the_needle(void)
+{
+	int rex_flags = NANO_REG_EXTENDED | (ISSET(CASE_SENSITIVE) ? 0 : REG_ICASE);
+
+	if (spotted_needle && strcmp(spotted_needle, last_search) == 0 &&
+						spotted_as_regexp == ISSET(USE_REGEXP) &&
+						spotted_with_case == ISSET(CASE_SENSITIVE))
+		return TRUE;
+
+	if (spotted_needle && spotted_as_regexp) {
+		regfree(&spotting_regexp);
+		free(spotting_leaders);
+		spotting_leaders = NULL;
+	}
+
+	free(spotted_needle);
+	spotted_needle = NULL;
+	counted_buffer = NULL;
+	ranked_line = NULL;
+
+	if (ISSET(USE_REGEXP)) {
+		if (regcomp(&spotting_regexp, last_search, rex_flags) != 0)
+			return FALSE;
+		spotting_leaders = leading_bytes(last_search, rex_flags & REG_ICASE, TRUE);
+	}
+
+	spotted_needle = copy_of(last_search);
+	spotted_size = strlen(last_search);
+	spotted_chars = mbstrlen(last_search);
+	spotted_as_regexp = ISSET(USE_REGEXP);
+	spotted_with_case = ISSET(CASE_SENSITIVE);
+
+	/* What is highlighted on the screen is no longer valid. */
+	forget_the_rows();
+	refresh_needed = TRUE;
+
+	return TRUE;
+}
+
+/* Return a pointer to the first occurrence of the spotted needle in the given
+ * text (which is fullsize bytes long) that begins at or after the given index
+ * and before the given limit, or NULL when there is none.  Set length to the
+ * length of the occurrence.  Beyond the limit, look only as far as the length
+ * of the needle (or, for a regex, a fixed amount), so that a short stretch of
+ * a long line is quickly done. */
+const char *next_spot(const char *text, size_t index, size_t fullsize,
+						size_t limit, size_t *length)
+{
+	size_t slack = (spotted_as_regexp) ? PAINT_LIMIT : spotted_size;
+	size_t reach = fullsize;
+	regmatch_t match;
+
+	if (spotted_needle == NULL)
+		return NULL;
+
+	if (limit < fullsize && fullsize - limit > slack)
+		reach = limit + slack;
+
+	if (!spotted_as_regexp) {
+		const char *spot;
+
+		*length = spotted_size;
+
+		/* When the search may run to the end of the text, use the fast way. */
+		if (reach == fullsize) {
+			spot = spotted_with_case ? strstr(text + index, spotted_needle) :
+										mbstrcasestr(text + index, spotted_needle);
+			return (spot && (size_t)(spot - text) < limit) ? spot : NULL;
+		}
+
+		for (; index < limit; index = step_right(text, index))
+			if (spotted_with_case ? strncmp(text + index, spotted_needle, spotted_size) == 0 :
+						mbstrncasecmp(text + index, spotted_needle, spotted_chars) == 0)
+				return text + index;
+
+		return NULL;
+	}
+
+	/* A match can begin only at one of the leading bytes, if these are known. */
+	if (spotting_leaders) {
+		while (index < limit && text[index] &&
+						!(spotting_leaders[(unsigned char)text[index] >> 3] &
+												(1 << (text[index] & 7))))
+			index++;
+
+		if (index >= limit || text[index] == '\0')
+			return NULL;
+	}
+
+	match.rm_so = index;
+	match.rm_eo = reach;
+
+	/* When not looking until the end of the text, '$' should not match. */
+	if (regexec(&spotting_regexp, text, 1, &match, REG_STARTEND |
+						(reach < fullsize ? REG_NOTEOL : 0)) != 0 ||
+						(size_t)match.rm_so >= limit)
+		return NULL;
+
+	*length = match.rm_eo - match.rm_so;
+	return text + match.rm_so;
+}
+
+/* Return the number of occurrences of the spotted needle in the given line
+ * that begin at or before the given index, stepping from one occurrence to
+ * the next in the same way that a repeated forward search does. */
+size_t spots_in(const linestruct *line, size_t upto)
+{
+	size_t fullsize = strlen(line->data);
+	size_t limit = (upto < fullsize) ? upto + 1 : fullsize + 1;
+	size_t index = 0, length, count = 0;
+	const char *spot;
+
+	/* Like findnextstr(), disregard anything on the magic line. */
+	if (line->next == NULL && line->data[0] == '\0')
+		return 0;
+
+	while ((spot = next_spot(line->data, index, fullsize, limit, &length))) {
+		count++;
+		if (*spot == '\0')
+			break;
+		index = step_right(line->data, spot - line->data);
+	}
+
+	return count;
+}
+
+/* Start counting the occurrences of the spotted needle in the current buffer,
+ * unless they were counted (or are being counted) already and no edits were
+ * made since. */
+void start_counting(void)
+{
+	if (counted_buffer == openfile && counted_stamp == edit_count)
+		return;
+
+	counted_number = 0;
+	counted_total = 0;
+	counting_line = openfile->filetop;
+	ranked_line = NULL;
+
+	counted_buffer = openfile;
+	counted_stamp = edit_count;
+}
+
+/* Return TRUE when the counting of occurrences in the current buffer
+ * is unfinished and can still be continued. */
+bool still_counting(void)
+{
+	return (counting_line && counted_buffer == openfile && counted_stamp == edit_count);
+}
+
+/* Report on the status bar which occurrence the cursor is on, and
+ * how many there are, when the counting is complete. */
+void show_the_rank(void)
+{
+	if (counting_line == NULL && ranked_wrapped)
+		statusline(REMARK, _("Match %zu of %zu (wrapped)"), ranked_rank, counted_total);
+	else if (counting_line == NULL)
+		statusline(REMARK, _("Match %zu of %zu"), ranked_rank, counted_total);
+	else if (ranked_wrapped)
+		statusline(REMARK, _("Match %zu (wrapped)"), ranked_rank);
+	else
+		statusline(REMARK, _("Match %zu"), ranked_rank);
+}
+
+/* Count the occurrences in at most the given number of lines more.  When this
+ * completes the counting while the cursor is still on the occurrence whose
+ * rank was reported without a total, report it again, now with the total. */
+void continue_counting(size_t howmany)
+{
+	static size_t space = 0;
+
+	while (counting_line && howmany-- > 0) {
+		size_t found = spots_in(counting_line, HIGHEST_POSITIVE);
+
+		if (found > 0) {
+			if (counted_number == space) {
+				space = (space == 0) ? 64 : 2 * space;
+				counted_lines = nrealloc(counted_lines, space * sizeof(linestruct *));
+				counted_before = nrealloc(counted_before, space * sizeof(size_t));
+			}
+
+			counted_lines[counted_number] = counting_line;
+			counted_before[counted_number++] = counted_total;
+			counted_total += found;
+		}
+
+		counting_line = counting_line->next;
+	}
+
+	if (counting_line == NULL && ranked_line == openfile->current &&
+				ranked_x == openfile->current_x && currmenu == MMAIN &&
+				lastmessage == REMARK) {
+		show_the_rank();
+		ranked_line = NULL;
+	}
+}
+
+/* Report on the status bar which occurrence the cursor is on, and how many
+ * there are.  The given line and x are where the search started.  Count only
+ * what is needed to know the rank right away, glancing at the keyboard once
+ * every second, so that a Cancel can skip the report; leave the rest of the
+ * counting to be done while waiting for the next keystroke. */
+void report_the_rank(const linestruct *was_current, size_t was_x)
+{
+	ssize_t lineno = openfile->current->lineno;
+	time_t lastkbcheck = time(NULL);
+	size_t low = 0, high;
+	bool cancelled = FALSE;
+
+	if (spotted_needle == NULL)
+		return;
+
+	start_counting();
+
+	nodelay(midwin, TRUE);
+
+	while (counting_line && counting_line->lineno < lineno && !cancelled) {
+		continue_counting(1000);
+
+		if (time(NULL) - lastkbcheck > 0) {
+			lastkbcheck = time(NULL);
+			cancelled = cancel_was_typed();
+		}
+	}
+
+	nodelay(midwin, FALSE);
+
+	if (cancelled)
+		return;
+
+	/* Find the first line with occurrences that is not before the current one. */
+	high = counted_number;
+	while (low < high) {
+		size_t middle = (low + high) / 2;
+
+		if (counted_lines[middle]->lineno < lineno)
+			low = middle + 1;
+		else
+			high = middle;
+	}
+
+	ranked_rank = (low < counted_number) ? counted_before[low] : counted_total;
+	ranked_rank += spots_in(openfile->current, openfile->current_x);
+
+	if (ISSET(BACKWARDS_SEARCH))
+		ranked_wrapped = (lineno > was_current->lineno || (lineno == was_current->lineno &&
+												openfile->current_x > was_x));
+	else
+		ranked_wrapped = (lineno < was_current->lineno || (lineno == was_current->lineno &&
+												openfile->current_x < was_x));
+
+	ranked_line = openfile->current;
+	ranked_x = openfile->current_x;
+
+	show_the_rank();
+}
+#endif /* !NANO_TINY */
+
 /* Search for the global string 'last_search'.  Inform the user when
  * the string occurs only once. */
 void go_looking(void)
@@ -435,10 +1237,20 @@ void go_looking(void)
 	didfind = findnextstr(last_search, FALSE, JUSTFIND, NULL, TRUE,
 								openfile->current, openfile->current_x);
 
+#ifndef NANO_TINY
+	/* When wanted, make the sought string the one to count and highlight. */
+	if (didfind == 1 && ISSET(SHOW_MATCHES) && !inhelp)
+		spot_the_needle();
+#endif
+
 	/* If we found something, and we're back at the exact same spot
 	 * where we started searching, then this is the only occurrence. */
 	if (didfind == 1 && openfile->current == was_current && openfile->current_x == was_x)
 		statusline(REMARK, _("This is the only occurrence"));
+#ifndef NANO_TINY
+	else if (didfind == 1 && ISSET(SHOW_MATCHES) && !inhelp)
+		report_the_rank(was_current, was_x);
+#endif
 	else if (didfind == 0)
 		not_found_msg(last_search);
 
@@ -518,6 +1330,22 @@ char *replace_line(const char *needle)
 	return copy;
 }
 
+/* Adjust the size of the file for the changes that were made to the given
+ * line, which held the given number of characters before these changes. */
+void settle_altered_line(linestruct *line, size_t was_count)
+{
+	openfile->totsize += mbstrlen(line->data) - was_count;
+
+#ifndef NANO_TINY
+	/* Store the file size after the change, to be used when redoing. */
+	openfile->current_undo->newsize = openfile->totsize;
+#endif
+#ifdef ENABLE_COLOR
+	check_the_multis(line);
+	refresh_needed = FALSE;
+#endif
+}
+
 /* Step through each occurrence of the search string and prompt the user
  * before replacing it.  We seek for needle, and replace it with answer.
  * The parameters real_current and real_current_x are needed in order to
@@ -532,7 +1360,13 @@ ssize_t do_replace_loop(const char *needle, bool whole_word_only,
 	int modus = REPLACING;
 	ssize_t numreplaced = -1;
 	size_t match_len;
+	linestruct *altered_line = NULL;
+		/* The line in which replacements are being made. */
+	size_t was_count = 0;
+		/* The number of characters in that line before the replacements. */
 #ifndef NANO_TINY
+	undostruct *collector = NULL;
+		/* The undo item that gathers all replacements after an "All". */
 	linestruct *was_mark = openfile->mark;
 	linestruct *top, *bot;
 	size_t top_x, bot_x;
@@ -613,15 +1447,32 @@ ssize_t do_replace_loop(const char *needle, bool whole_word_only,
 		}
 
 		if (choice == YES || replaceall) {
+			bool other_line = (openfile->current != altered_line);
 			size_t length_change;
 			char *altered;
 
+			/* When moving on to another line, first settle the previous one. */
+			if (other_line) {
+				if (altered_line)
+					settle_altered_line(altered_line, was_count);
+				altered_line = openfile->current;
+				was_count = mbstrlen(altered_line->data);
+			}
+
 			altered = replace_line(needle);
 
 			length_change = strlen(altered) - strlen(openfile->current->data);
 
 #ifndef NANO_TINY
-			add_undo(REPLACE, NULL);
+			/* After an "All", let a single undo item collect the original
+			 * contents of all lines that get changed, each just once. */
+			if (collector == NULL || collector != openfile->current_undo)
+				add_undo(REPLACE, NULL);
+			else if (other_line && openfile->current->lineno != collector->head_lineno)
+				update_multiline_undo(openfile->current->lineno, openfile->current->data);
+
+			if (replaceall)
+				collector = openfile->current_undo;
 
 			/* If the mark was on and it was located after the cursor,
 			 * then adjust its x position for any text length changes. */
@@ -661,21 +1512,26 @@ ssize_t do_replace_loop(const char *needle, bool whole_word_only,
 			if (!ISSET(BACKWARDS_SEARCH))
 				openfile->current_x += match_len + length_change;
 
-			/* Update the file size, and put the changed line into place. */
-			openfile->totsize += mbstrlen(altered) - mbstrlen(openfile->current->data);
+			/* Put the changed line into place. */
 			free(openfile->current->data);
 			openfile->current->data = altered;
+			mark_as_changed(openfile->current);
+
+			/* When replacing all, settle the line only when done with it. */
+			if (!replaceall) {
+				settle_altered_line(altered_line, was_count);
+				altered_line = NULL;
+			}
 
-#ifdef ENABLE_COLOR
-			check_the_multis(openfile->current);
-			refresh_needed = FALSE;
-#endif
 			set_modified();
 			as_an_at = TRUE;
 			numreplaced++;
 		}
 	}
 
+	if (altered_line)
+		settle_altered_line(altered_line, was_count);
+
 	if (numreplaced == -1)
 		not_found_msg(needle);
 
@@ -821,6 +1677,12 @@ void goto_line_and_column(ssize_t line, ssize_t column, bool hugfloor)
 {
 	int rows_from_tail;
 
+#ifndef NANO_TINY
+	/* When the line has not been read in yet, first read on until it has;
+	 * for a line counted from the end, the whole file needs to be read. */
+	load_up_to((line < 0) ? HIGHEST_POSITIVE : line);
+#endif
+
 	/* Take a negative line number to mean: from the end of the file. */
 	if (line < 0)
 		line = openfile->filebot->lineno + line + 1;
@@ -835,10 +1697,11 @@ void goto_line_and_column(ssize_t line, ssize_t column, bool hugfloor)
 		recook |= perturbed;
 #endif
 
-	/* Iterate to the requested line. */
-	for (openfile->current = openfile->filetop; line > 1 &&
-				openfile->current != openfile->filebot; line--)
-		openfile->current = openfile->current->next;
+	/* Go to the requested line, or to the last line if it is beyond. */
+	if (line < openfile->filebot->lineno)
+		openfile->current = line_from_number(line);
+	else
+		openfile->current = openfile->filebot;
 
 	/* Take a negative column number to mean: from the end of the line. */
 	if (column < 0)
@@ -31,6 +31,9 @@
 #include <time.h>
 #include <unistd.h>
 #include <sys/wait.h>
+#ifdef USE_POSIX_THREADS
+#include <pthread.h>
+#endif
 
 #ifndef NANO_TINY
 /* Toggle the mark. */
@@ -95,6 +98,7 @@ void indent_a_line(linestruct *line, char *indentation)
 	line->data = nrealloc(line->data, length + indent_len + 1);
 	memmove(line->data + indent_len, line->data, length + 1);
 	memcpy(line->data, indentation, indent_len);
+	mark_as_changed(line);
 
 	openfile->totsize += indent_len;
 
@@ -223,6 +227,7 @@ void unindent_a_line(linestruct *line, size_t indent_len)
 
 	/* Remove the first tab's worth of whitespace from this line. */
 	memmove(line->data, line->data + indent_len, length - indent_len + 1);
+	mark_as_changed(line);
 
 	openfile->totsize -= indent_len;
 
@@ -295,6 +300,31 @@ void handle_indent_action(undostruct *u, bool undoing, bool add_indent)
 
 	refresh_needed = TRUE;
 }
+
+/* Exchange the contents of the lines in the groups of the given undo item
+ * with the contents stored in those groups. */
+void exchange_grouped_lines(undostruct *u)
+{
+	for (groupstruct *group = u->grouping; group != NULL; group = group->next) {
+		linestruct *line = line_from_number(group->top_line);
+
+		for (ssize_t index = 0; index <= group->bottom_line - group->top_line; index++) {
+			char *data = group->indentations[index];
+
+			group->indentations[index] = line->data;
+			line->data = data;
+			mark_as_changed(line);
+			line = line->next;
+		}
+	}
+
+	if (u->grouping) {
+#ifdef ENABLE_COLOR
+		recook = TRUE;
+#endif
+		refresh_needed = TRUE;
+	}
+}
 #endif /* !NANO_TINY */
 
 #ifdef ENABLE_COMMENT
@@ -323,6 +353,7 @@ bool comment_line(undo_type action, linestruct *line, const char *comment_seq)
 		memmove(line->data, comment_seq, pre_len);
 		if (post_len > 0)
 			memmove(line->data + pre_len + line_len, post_seq, post_len + 1);
+		mark_as_changed(line);
 
 		openfile->totsize += pre_len + post_len;
 
@@ -348,6 +379,7 @@ bool comment_line(undo_type action, linestruct *line, const char *comment_seq)
 		memmove(line->data, line->data + pre_len, line_len - pre_len);
 		/* Truncate the postfix if there was one. */
 		line->data[line_len - pre_len - post_len] = '\0';
+		mark_as_changed(line);
 
 		openfile->totsize -= pre_len + post_len;
 
@@ -507,8 +539,15 @@ void do_undo(void)
 		return;
 	}
 
-	if (u->type <= REPLACE)
+	if (!page_in_undo_data(u)) {
+		statusline(ALERT, _("Could not read back undo data"));
+		return;
+	}
+
+	if (u->type <= REPLACE) {
 		line = line_from_number(u->tail_lineno);
+		mark_as_changed(line);
+	}
 
 	switch (u->type) {
 	case ADD:
@@ -533,7 +572,7 @@ void do_undo(void)
 		strcat(line->data, &u->strdata[regain_from_x]);
 		line->has_anchor |= line->next->has_anchor;
 		unlink_node(line->next);
-		renumber_from(line);
+		renumber_lazily_from(line, line);
 		openfile->current = line;
 		goto_line_posx(u->head_lineno, original_x);
 		break;
@@ -562,7 +601,7 @@ void do_undo(void)
 		intruder = make_new_node(line);
 		intruder->data = copy_of(u->strdata);
 		splice_node(line, intruder);
-		renumber_from(intruder);
+		renumber_lazily_from(intruder, intruder);
 		goto_line_posx(u->head_lineno, u->head_x);
 		break;
 	case REPLACE:
@@ -570,6 +609,7 @@ void do_undo(void)
 		data = u->strdata;
 		u->strdata = line->data;
 		line->data = data;
+		exchange_grouped_lines(u);
 		goto_line_posx(u->head_lineno, u->head_x);
 		break;
 #ifdef ENABLE_WRAPPING
@@ -671,6 +711,7 @@ void do_undo(void)
 	if (openfile->current_undo == openfile->last_saved) {
 		openfile->modified = FALSE;
 		titlebar(NULL);
+		edit_count++;
 	} else
 		set_modified();
 }
@@ -694,8 +735,15 @@ void do_redo(void)
 	while (u->next != openfile->current_undo)
 		u = u->next;
 
-	if (u->type <= REPLACE)
+	if (!page_in_undo_data(u)) {
+		statusline(ALERT, _("Could not read back undo data"));
+		return;
+	}
+
+	if (u->type <= REPLACE) {
 		line = line_from_number(u->tail_lineno);
+		mark_as_changed(line);
+	}
 
 	switch (u->type) {
 	case ADD:
@@ -716,7 +764,7 @@ void do_redo(void)
 		intruder = make_new_node(line);
 		intruder->data = copy_of(u->strdata);
 		splice_node(line, intruder);
-		renumber_from(intruder);
+		renumber_lazily_from(intruder, intruder);
 		goto_line_posx(u->head_lineno + 1, u->tail_x);
 		break;
 	case BACK:
@@ -738,7 +786,7 @@ void do_redo(void)
 		line->data = nrealloc(line->data, strlen(line->data) + strlen(u->strdata) + 1);
 		strcat(line->data, u->strdata);
 		unlink_node(line->next);
-		renumber_from(line);
+		renumber_lazily_from(line, line);
 		openfile->current = line;
 		goto_line_posx(u->tail_lineno, u->tail_x);
 		break;
@@ -747,6 +795,7 @@ void do_redo(void)
 		data = u->strdata;
 		u->strdata = line->data;
 		line->data = data;
+		exchange_grouped_lines(u);
 		goto_line_posx(u->head_lineno, u->head_x);
 		break;
 #ifdef ENABLE_WRAPPING
@@ -840,6 +889,7 @@ void do_redo(void)
 	if (openfile->current_undo == openfile->last_saved) {
 		openfile->modified = FALSE;
 		titlebar(NULL);
+		edit_count++;
 	} else if (!suppress_modification)
 		set_modified();
 }
@@ -895,6 +945,7 @@ void do_enter(void)
 
 	/* Make the current line end at the cursor position. */
 	openfile->current->data[openfile->current_x] = '\0';
+	mark_as_changed(openfile->current);
 
 #ifndef NANO_TINY
 	add_undo(ENTER, NULL);
@@ -902,7 +953,7 @@ void do_enter(void)
 
 	/* Insert the newly created line after the current one and renumber. */
 	splice_node(openfile->current, newnode);
-	renumber_from(newnode);
+	renumber_lazily_from(newnode, newnode);
 
 	/* Put the cursor on the new line, after any automatic whitespace. */
 	openfile->current = newnode;
@@ -923,24 +974,36 @@ void do_enter(void)
 }
 
 #ifndef NANO_TINY
+static FILE *journal = NULL;
+		/* The temporary file to which the data of old undo items are moved. */
+
+/* Free the given undo item and its data, and deduct its weight. */
+void free_undo_item(undostruct *item)
+{
+	groupstruct *group = item->grouping;
+
+	while (group) {
+		groupstruct *next = group->next;
+		free_chararray(group->indentations, group->bottom_line - group->top_line + 1);
+		free(group);
+		group = next;
+	}
+
+	openfile->undo_weight -= item->weight;
+
+	free(item->strdata);
+	free_lines(item->cutbuffer);
+	free(item);
+}
+
 /* Discard undo items that are newer than the given one, or all if NULL. */
 void discard_until(const undostruct *thisitem)
 {
 	undostruct *dropit = openfile->undotop;
-	groupstruct *group;
 
 	while (dropit && dropit != thisitem) {
 		openfile->undotop = dropit->next;
-		free(dropit->strdata);
-		free_lines(dropit->cutbuffer);
-		group = dropit->grouping;
-		while (group) {
-			groupstruct *next = group->next;
-			free_chararray(group->indentations, group->bottom_line - group->top_line + 1);
-			free(group);
-			group = next;
-		}
-		free(dropit);
+		free_undo_item(dropit);
 		dropit = openfile->undotop;
 	}
 
@@ -951,6 +1014,155 @@ void discard_until(const undostruct *thisitem)
 	openfile->last_action = OTHER;
 }
 
+/* Return the (approximate) amount of memory taken by the given undo item. */
+size_t weight_of(const undostruct *item)
+{
+	size_t weight = sizeof(undostruct);
+
+	if (item->strdata)
+		weight += strlen(item->strdata) + 1;
+
+	for (const linestruct *line = item->cutbuffer; line != NULL; line = line->next)
+		weight += sizeof(linestruct) + strlen(line->data) + 1;
+
+	for (const groupstruct *group = item->grouping; group != NULL; group = group->next) {
+		weight += sizeof(groupstruct);
+		for (ssize_t index = 0; group->indentations &&
+							index <= group->bottom_line - group->top_line; index++)
+			weight += sizeof(char *) + strlen(group->indentations[index]) + 1;
+	}
+
+	return weight;
+}
+
+/* Write the text and the lines of the given undo item to the journal (unless
+ * they were written there earlier), and free them.  Return FALSE when the
+ * journal could not be written. */
+bool spill_undo_data(undostruct *item)
+{
+	if (item->spot < 0) {
+		size_t length = (item->strdata) ? strlen(item->strdata) + 1 : 0;
+		size_t count = 0;
+		off_t spot;
+
+		if (journal == NULL)
+			journal = tmpfile();
+
+		if (journal == NULL || fseeko(journal, 0, SEEK_END) != 0 ||
+								(spot = ftello(journal)) < 0)
+			return FALSE;
+
+		for (linestruct *line = item->cutbuffer; line != NULL; line = line->next)
+			count++;
+
+		fwrite(&length, sizeof(size_t), 1, journal);
+		if (length > 0)
+			fwrite(item->strdata, 1, length, journal);
+		fwrite(&count, sizeof(size_t), 1, journal);
+
+		for (linestruct *line = item->cutbuffer; line != NULL; line = line->next) {
+			length = strlen(line->data);
+			fwrite(&length, sizeof(size_t), 1, journal);
+			fwrite(line->data, 1, length, journal);
+			fputc(line->has_anchor, journal);
+		}
+
+		if (fflush(journal) != 0 || ferror(journal)) {
+			clearerr(journal);
+			return FALSE;
+		}
+
+		item->spot = spot;
+	}
+
+	free(item->strdata);
+	item->strdata = NULL;
+	free_lines(item->cutbuffer);
+	item->cutbuffer = NULL;
+
+	return TRUE;
+}
+
+/* Read back from the journal the text and the lines of the given undo item,
+ * if they were moved there.  Return FALSE when they could not be read. */
+bool page_in_undo_data(undostruct *item)
+{
+	linestruct *line = NULL;
+	size_t length, count;
+	bool intact;
+
+	if (item->spot < 0 || item->strdata || item->cutbuffer)
+		return TRUE;
+
+	intact = (fseeko(journal, item->spot, SEEK_SET) == 0 &&
+				fread(&length, sizeof(size_t), 1, journal) == 1);
+
+	if (intact && length > 0) {
+		item->strdata = nmalloc(length);
+		intact = (fread(item->strdata, 1, length, journal) == length);
+	}
+
+	intact = intact && (fread(&count, sizeof(size_t), 1, journal) == 1);
+
+	while (intact && count-- > 0) {
+		intact = (fread(&length, sizeof(size_t), 1, journal) == 1);
+		if (!intact)
+			break;
+
+		line = make_new_node(line);
+		line->data = nmalloc(length + 1);
+		line->data[length] = '\0';
+
+		if (line->prev)
+			line->prev->next = line;
+		else
+			item->cutbuffer = line;
+
+		intact = (fread(line->data, 1, length, journal) == length);
+		line->has_anchor = (fgetc(journal) == TRUE);
+	}
+
+	if (!intact) {
+		clearerr(journal);
+		spill_undo_data(item);
+		return FALSE;
+	}
+
+	openfile->undo_weight -= item->weight;
+	item->weight = weight_of(item);
+	openfile->undo_weight += item->weight;
+
+	return TRUE;
+}
+
+/* When the undo data of the current buffer take more memory than allowed,
+ * move the data of the older undo items to the journal on disk, from where
+ * they will be read back when the item gets undone or redone.  The items
+ * themselves (and thus the full undo history) stay in place. */
+void lighten_the_undo_stack(void)
+{
+	size_t limit = (size_t)undo_limit << 20;
+	size_t total = 0;
+
+	if (undo_limit == 0 || openfile->undo_weight <= limit)
+		return;
+
+	/* Going from the newest item to older ones, spill the data of each
+	 * item that goes beyond the limit. */
+	for (undostruct *item = openfile->undotop; item != NULL; item = item->next) {
+		total += item->weight;
+
+		if (total > limit && item->weight > 0 && (item->strdata || item->cutbuffer)) {
+			if (!spill_undo_data(item))
+				return;
+
+			openfile->undo_weight -= item->weight;
+			item->weight = weight_of(item);
+			openfile->undo_weight += item->weight;
+		}
+	}
+}
+
 /* Add a new undo item of the given type to the top of the current pile. */
 void add_undo(undo_type action, const char *message)
 {
@@ -968,6 +1180,8 @@ void add_undo(undo_type action, const char *message)
 	u->wassize = openfile->totsize;
 	u->newsize = openfile->totsize;
 	u->grouping = NULL;
+	u->weight = 0;
+	u->spot = -1;
 	u->xflags = 0;
 
 	/* Blow away any undone items. */
@@ -982,9 +1196,20 @@ void add_undo(undo_type action, const char *message)
 		u->wassize = openfile->undotop->wassize;
 		u->next = openfile->undotop->next;
 		openfile->undotop->next = u;
+		/* This item stays empty, so it can be weighed right away. */
+		u->weight = weight_of(u);
+		openfile->undo_weight += u->weight;
 	} else
 #endif
 	{
+		/* The item that gets covered is complete, so weigh it, and when
+		 * the undo data have grown too big, move the oldest ones to disk. */
+		if (openfile->undotop && openfile->undotop->weight == 0) {
+			openfile->undotop->weight = weight_of(openfile->undotop);
+			openfile->undo_weight += openfile->undotop->weight;
+			lighten_the_undo_stack();
+		}
+
 		u->next = openfile->undotop;
 		openfile->undotop = u;
 		openfile->current_undo = u;
@@ -1302,6 +1527,7 @@ void do_wrap(void)
 			line->data = nrealloc(line->data, line_len + 2);
 			line->data[line_len] = ' ';
 			line->data[line_len + 1] = '\0';
+			mark_as_changed(line);
 			rest_length++;
 			openfile->totsize++;
 			openfile->current_x++;
@@ -1359,6 +1585,7 @@ void do_wrap(void)
 
 		memmove(line->data + lead_len, line->data, line_len + 1);
 		strncpy(line->data, line->prev->data, lead_len);
+		mark_as_changed(line);
 
 		openfile->current_x += lead_len;
 		openfile->totsize += lead_len;
@@ -1587,6 +1814,7 @@ void concat_paragraph(linestruct *line, size_t count)
 
 		line->data = nrealloc(line->data, line_len + next_line_len - next_lead_len + 1);
 		strcat(line->data, next_line->data + next_lead_len);
+		mark_as_changed(line);
 #ifndef NANO_TINY
 		line->has_anchor |= next_line->has_anchor;
 #endif
@@ -1654,6 +1882,8 @@ void squeeze(linestruct *line, size_t skip)
 		to--;
 
 	*to = '\0';
+
+	mark_as_changed(line);
 }
 
 /* Rewrap the given line (that starts with the given lead string which is of
@@ -1693,6 +1923,7 @@ void rewrap_paragraph(linestruct **line, char *lead_string, size_t lead_len)
 
 		/* Now actually break the current line, and go to the next. */
 		(*line)->data[break_pos] = '\0';
+		mark_as_changed(*line);
 		*line = (*line)->next;
 	}
 
@@ -1929,6 +2160,8 @@ void justify_text(bool whole_buffer)
 			strncpy(line->data, primary_lead, primary_len);
 		}
 
+		mark_as_changed(line);
+
 		/* Now justify the extracted region. */
 		concat_paragraph(cutbuffer, linecount);
 		squeeze(cutbuffer, primary_len);
@@ -2109,7 +2342,7 @@ bool replace_buffer(const char *filename, undo_type action, const char *operatio
 /* Execute the given program, with the given temp file as last argument. */
 void treat(char *tempfile_name, char *theprogram, bool spelling)
 {
-#if defined(HAVE_FORK) && defined(HAVE_WAIT)
+#if defined(HAVE_FORK) && defined(HAVE_WAITPID)
 	ssize_t was_lineno = openfile->current->lineno;
 	size_t was_pww = openfile->placewewant;
 	size_t was_x = openfile->current_x;
@@ -2157,7 +2390,7 @@ void treat(char *tempfile_name, char *theprogram, bool spelling)
 		/* Block SIGWINCHes while waiting for the forked program to end,
 		 * so nano doesn't get pushed past the wait(). */
 		block_sigwinch(TRUE);
-		wait(&program_status);
+		waitpid(thepid, &program_status, 0);
 		block_sigwinch(FALSE);
 	}
 
@@ -2993,12 +3226,201 @@ void do_formatter(void)
 #endif /* ENABLE_FORMATTER */
 
 #ifndef NANO_TINY
+#ifdef USE_POSIX_THREADS
+/* The most threads that will share the counting of words. */
+#define MAX_COUNTERS  32
+/* The least number of lines that makes it worth starting another thread. */
+#define LINES_PER_COUNTER  50000
+
+typedef struct counterstruct {
+	pthread_t thread;
+		/* The identifier of the thread that counts this stretch. */
+	const linestruct *first;
+		/* The first line of the stretch. */
+	const linestruct *stopper;
+		/* The line after the stretch. */
+	const linestruct *botline;
+		/* The last line of the area, which is counted only up to bot_x. */
+	size_t bot_x;
+		/* Where the area ends on its last line. */
+	size_t words;
+		/* The number of words found in the stretch. */
+} counterstruct;
+#endif
+
+static signed char word_kind[256];
+		/* For each byte, whether it is a word character (1) or a separator (0),
+		 * or whether it may start a multibyte character that needs a closer
+		 * look (-1). */
+static bool punct_in_words;
+		/* Whether punctuation counts as part of a word. */
+
+/* Count the words that begin in the given text between x and end, where
+ * seen_space says whether a separator precedes position x. */
+static size_t words_from(const char *data, size_t x, size_t end, bool seen_space)
+{
+	size_t words = 0;
+
+	while (x < end && data[x] != '\0') {
+		signed char sort = word_kind[(unsigned char)data[x]];
+
+		if (sort < 0) {
+#ifdef ENABLE_UTF8
+			if (is_zerowidth(data + x))
+				sort = -1;
+			else
+#endif
+				sort = is_word_char(data + x, punct_in_words) ? 1 : 0;
+
+			x += char_length(data + x);
+		} else
+			x++;
+
+		if (sort == 0)
+			seen_space = TRUE;
+		else if (sort > 0 && seen_space) {
+			seen_space = FALSE;
+			words++;
+		}
+	}
+
+	return words;
+}
+
+/* Count the words on the lines from the given one up to the stopper, taking
+ * the given bottom line only up to bot_x.  Each line starts a fresh word. */
+static size_t words_on_lines(const linestruct *line, const linestruct *stopper,
+								const linestruct *botline, size_t bot_x)
+{
+	size_t words = 0;
+
+	for (; line != stopper; line = line->next)
+		words += words_from(line->data, 0, (line == botline) ? bot_x : HIGHEST_POSITIVE, TRUE);
+
+	return words;
+}
+
+#ifdef USE_POSIX_THREADS
+/* Count the words in the stretch of lines that was assigned to a thread. */
+static void *count_a_stretch(void *data)
+{
+	counterstruct *counter = data;
+
+	counter->words = words_on_lines(counter->first, counter->stopper,
+										counter->botline, counter->bot_x);
+	return NULL;
+}
+
+/* Count the words on the lines from first through botline (the latter up to
+ * bot_x) with the given number of threads, the current one included, each
+ * taking an equal number of lines.  As a line never continues a word from the
+ * line before it, the counts of the stretches can simply be added up. */
+static size_t words_in_parallel(const linestruct *first, const linestruct *botline,
+								size_t bot_x, int threads)
+{
+	ssize_t span = botline->lineno - first->lineno + 1;
+	counterstruct counter[MAX_COUNTERS];
+	sigset_t allsignals, oldmask;
+	size_t words = 0;
+	int started;
+
+	for (int index = 0; index < threads; index++) {
+		counter[index].first = (index == 0) ? first :
+						line_from_number(first->lineno + index * span / threads);
+		counter[index].botline = botline;
+		counter[index].bot_x = bot_x;
+	}
+
+	for (int index = 0; index < threads; index++)
+		counter[index].stopper = (index + 1 < threads) ? counter[index + 1].first : botline->next;
+
+	/* Leave the handling of any signals to the current thread. */
+	sigfillset(&allsignals);
+	pthread_sigmask(SIG_SETMASK, &allsignals, &oldmask);
+
+	for (started = 1; started < threads; started++)
+		if (pthread_create(&counter[started].thread, NULL, count_a_stretch, &counter[started]) != 0)
+			break;
+
+	pthread_sigmask(SIG_SETMASK, &oldmask, NULL);
+
+	count_a_stretch(&counter[0]);
+
+	/* Count any stretches for which no thread could be started. */
+	for (int index = started; index < threads; index++)
+		count_a_stretch(&counter[index]);
+
+	for (int index = 1; index < started; index++)
+		pthread_join(counter[index].thread, NULL);
+
+	for (int index = 0; index < threads; index++)
+		words += counter[index].words;
+
+	return words;
+}
+#endif
+
+/* Count the words in the given area in the same way as stepping from word
+ * to word would count them: a word begins at a word character that follows
+ * a separator or the start of a line, and zero-width characters are ignored.
+ * Single-byte characters are classified just once, through a table.  On a
+ * machine with several processors, the lines of a large area are divided
+ * among a number of threads. */
+size_t number_of_words_in(const linestruct *topline, size_t top_x,
+								const linestruct *botline, size_t bot_x)
+{
+	const char *data = topline->data;
+	size_t x = top_x, words = 0;
+#ifdef USE_POSIX_THREADS
+	long threads = sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+	bool seen_space;
+
+	if (topline == botline && top_x >= bot_x)
+		return 0;
+
+	punct_in_words = ISSET(WORD_BOUNDS);
+
+	/* Mark which bytes are word characters (1) and which are separators (0).
+	 * Bytes that may start a multibyte character need a closer look (-1). */
+	for (int byte = 1; byte < 256; byte++) {
+		char symbol[2] = { byte, '\0' };
+
+		if (byte >= 0x80 && using_utf8)
+			word_kind[byte] = -1;
+		else
+			word_kind[byte] = is_word_char(symbol, punct_in_words) ? 1 : 0;
+	}
+
+	/* The starting position counts when it is on a word character. */
+	seen_space = !is_word_char(data + x, punct_in_words);
+	words += seen_space ? 0 : 1;
+
+	if (data[x] != '\0')
+		x = step_right(data, x);
+
+	words += words_from(data, x, (topline == botline) ? bot_x : HIGHEST_POSITIVE, seen_space);
+
+	if (topline == botline)
+		return words;
+
+#ifdef USE_POSIX_THREADS
+	if (threads > (botline->lineno - topline->lineno) / LINES_PER_COUNTER)
+		threads = (botline->lineno - topline->lineno) / LINES_PER_COUNTER;
+	if (threads > MAX_COUNTERS)
+		threads = MAX_COUNTERS;
+
+	if (threads > 1)
+		return words + words_in_parallel(topline->next, botline, bot_x, threads);
+#endif
+
+	return words + words_on_lines(topline->next, botline->next, botline, bot_x);
+}
+
 /* Our own version of "wc".  Note that the character count is in
  * multibyte characters instead of single-byte characters. */
 void count_lines_words_and_characters(void)
 {
-	linestruct *was_current = openfile->current;
-	size_t was_x = openfile->current_x;
 	linestruct *topline, *botline;
 	size_t top_x, bot_x;
 	size_t words = 0, chars = 0;
@@ -3026,21 +3448,7 @@ void count_lines_words_and_characters(void)
 	lines = botline->lineno - topline->lineno;
 	lines += (bot_x == 0 || (topline == botline && top_x == bot_x)) ? 0 : 1;
 
-	openfile->current = topline;
-	openfile->current_x = top_x;
-
-	/* Keep stepping to the next word (considering punctuation as part of a
-	 * word, as "wc -w" does), until we reach the end of the relevant area,
-	 * incrementing the word count for each successful step. */
-	while (openfile->current->lineno < botline->lineno ||
-				(openfile->current == botline && openfile->current_x < bot_x)) {
-		if (do_next_word(FALSE))
-			words++;
-	}
-
-	/* Restore where we were. */
-	openfile->current = was_current;
-	openfile->current_x = was_x;
+	words = number_of_words_in(topline, top_x, botline, bot_x);
 
 	/* Report on the status bar the number of lines, words, and characters. */
 	statusline(INFO, _("%s%zd %s,  %zu %s,  %zu %s"),
@@ -159,12 +159,10 @@ bool parse_line_column(const char *string, ssize_t *line, ssize_t *column)
 /* In the given string, recode each embedded NUL as a newline. */
 void recode_NUL_to_LF(char *string, size_t length)
 {
-	while (length > 0) {
-		if (*string == '\0')
-			*string = '\n';
-		length--;
-		string++;
-	}
+	char *end = string + length;
+
+	while ((string = memchr(string, '\0', end - string)) != NULL)
+		*(string++) = '\n';
 }
 
 /* In the given string, recode each embedded newline as a NUL,
@@ -217,10 +215,24 @@ bool is_separate_word(size_t position, size_t length, const char *text)
 const char *strstrwrapper(const char *haystack, const char *needle, const char *start)
 {
 	if (ISSET(USE_REGEXP)) {
+		/* When no byte of the relevant part of the line can begin a match,
+		 * there is no need to run the regex. */
+		if (search_leaders) {
+			const char *text = ISSET(BACKWARDS_SEARCH) ? haystack : start;
+
+			while (*text && !(search_leaders[(unsigned char)*text >> 3] & (1 << (*text & 7))))
+				text++;
+
+			if (*text == '\0')
+				return NULL;
+		}
+
 		if (ISSET(BACKWARDS_SEARCH)) {
 			size_t last_find, ceiling, far_end;
 			size_t floor = 0, next_rung = 0;
 				/* The start of the search range, and the next start. */
+			size_t reach = 256;
+				/* How far before the ceiling to start looking for a match. */
 
 			if (regexec(&search_regexp, haystack, 1, regmatches, 0) != 0)
 				return NULL;
@@ -233,6 +245,33 @@ const char *strstrwrapper(const char *haystack, const char *needle, const char *
 			if (last_find > ceiling)
 				return NULL;
 
+			/* Instead of stepping through all matches from the start of the line,
+			 * first look for a match in a stretch just before the ceiling, making
+			 * the stretch longer while it contains none -- but not reaching back
+			 * beyond the first match in the line. */
+			while (ceiling - last_find > reach) {
+				size_t rung = ceiling - reach;
+
+				/* Begin at the start of a character. */
+				while (using_utf8 && rung > last_find &&
+								((unsigned char)haystack[rung] & 0xC0) == 0x80)
+					rung--;
+
+				regmatches[0].rm_so = rung;
+				regmatches[0].rm_eo = far_end;
+				if (regexec(&search_regexp, haystack, 1, regmatches, REG_STARTEND) == 0 &&
+											(size_t)regmatches[0].rm_so <= ceiling) {
+					next_rung = rung;
+					break;
+				}
+
+				reach *= 4;
+			}
+
+			/* When no stretch contained a match, start from the first one. */
+			if (next_rung == 0)
+				regmatches[0].rm_so = last_find;
+
 			/* Move the start-of-range forward until there is no more match;
 			 * then the last match found is the first match backwards. */
 			while (regmatches[0].rm_so <= ceiling) {
@@ -367,37 +406,154 @@ size_t get_page_start(size_t column)
 		return column - (editwincols - 2);
 }
 
+/* The number of bytes between two checkpoints in a long line. */
+#define CHECKPOINT_GAP  4096
+
+/* Find the last checkpoint in the given text whose byte offset is below
+ * the given limit (or, when by_column is TRUE, whose column is not beyond
+ * it), setting more checkpoints when needed.  Return the byte offset of
+ * that checkpoint, and set column to its column.  When the text is not that
+ * of the current line nor of the hinted line, or is short, just return the
+ * start of the text. */
+size_t nearest_checkpoint(const char *text, size_t limit, bool by_column, size_t *column)
+{
+	const linestruct *line;
+	cachestruct *entry;
+	checkstruct *checks;
+	size_t index;
+
+	*column = 0;
+
+	if (!by_column && limit <= CHECKPOINT_GAP)
+		return 0;
+
+	line = owner_of(text);
+
+	if (line == NULL || strnlen(text, CHECKPOINT_GAP + 1) <= CHECKPOINT_GAP)
+		return 0;
+
+	entry = cache_for(line);
+
+	if (entry->checks == NULL) {
+		entry->checks = nmalloc(sizeof(checkstruct));
+		entry->checks->room = 64;
+		entry->checks->x = nmalloc(entry->checks->room * sizeof(size_t));
+		entry->checks->column = nmalloc(entry->checks->room * sizeof(size_t));
+		entry->checks->count = 0;
+	}
+
+	checks = entry->checks;
+
+	/* When the line was changed since the checkpoints were set, start over. */
+	if (checks->count == 0 || checks->version != line->version) {
+		checks->version = line->version;
+		checks->x[0] = 0;
+		checks->column[0] = 0;
+		checks->count = 1;
+	}
+
+	/* Set further checkpoints until one lies beyond the limit. */
+	while (text[checks->x[checks->count - 1]] && (by_column ?
+					checks->column[checks->count - 1] <= limit :
+					checks->x[checks->count - 1] < limit)) {
+		size_t target = checks->count * CHECKPOINT_GAP;
+
+		index = checks->x[checks->count - 1];
+		*column = checks->column[checks->count - 1];
+
+		while (text[index] && index < target)
+			index += advance_over(text + index, column);
+
+		if (checks->count == checks->room) {
+			checks->room *= 2;
+			checks->x = nrealloc(checks->x, checks->room * sizeof(size_t));
+			checks->column = nrealloc(checks->column, checks->room * sizeof(size_t));
+		}
+
+		checks->x[checks->count] = index;
+		checks->column[checks->count] = *column;
+		checks->count++;
+	}
+
+	/* Look for the last checkpoint that is not beyond the limit. */
+	size_t low = 0, high = checks->count - 1;
+
+	while (low < high) {
+		size_t middle = (low + high + 1) / 2;
+
+		if (by_column ? checks->column[middle] <= limit : checks->x[middle] < limit)
+			low = middle;
+		else
+			high = middle - 1;
+	}
+
+	*column = checks->column[low];
+
+	return checks->x[low];
+}
+
 /* Return the index in the given text of the character that (when displayed)
  * will not overshoot the given column. */
 size_t actual_x(const char *text, size_t column)
 {
-	const char *start = text;
-		/* From where we start walking through the text. */
-	size_t width = 0;
+	size_t width;
 		/* The current accumulated span, in columns. */
+	size_t index = nearest_checkpoint(text, column, TRUE, &width);
+		/* From where we start walking through the text. */
 
-	while (*text) {
-		int charlen = advance_over(text, &width);
+	while (text[index]) {
+		int charlen;
+
+		/* Skip over plain characters (one byte, one column) in one go. */
+		if (width < column && (signed char)text[index] >= ' ') {
+			size_t run = ascii_run(text + index, column - width, TRUE);
+
+			index += run;
+			width += run;
+
+			if (run > 0)
+				continue;
+		}
+
+		charlen = advance_over(text + index, &width);
 
 		if (width > column)
 			break;
 
-		text += charlen;
+		index += charlen;
 	}
 
-	return (text - start);
+	return index;
 }
 
 /* Return the number of columns that the first count bytes of text occupy. */
 size_t wideness(const char *text, size_t count)
 {
-	size_t width = 0;
+	size_t width;
+	size_t index = nearest_checkpoint(text, count, FALSE, &width);
 
 	if (count == 0)
 		return 0;
 
+	text += index;
+	count -= index;
+
 	while (*text) {
-		size_t charlen = advance_over(text, &width);
+		size_t charlen;
+
+		/* Skip over plain characters (one byte, one column) in one go. */
+		if (count > 1 && (signed char)*text >= ' ') {
+			size_t run = ascii_run(text, count - 1, TRUE);
+
+			text += run;
+			width += run;
+			count -= run;
+
+			if (run > 0)
+				continue;
+		}
+
+		charlen = advance_over(text, &width);
 
 		if (count <= charlen)
 			break;
@@ -412,10 +568,23 @@ size_t wideness(const char *text, size_t count)
 /* Return the number of columns that the given text occupies. */
 size_t breadth(const char *text)
 {
-	size_t span = 0;
+	size_t span;
+	size_t index = nearest_checkpoint(text, HIGHEST_POSITIVE, FALSE, &span);
+
+	while (text[index]) {
+		/* Skip over plain characters (one byte, one column) in one go. */
+		if ((signed char)text[index] >= ' ') {
+			size_t run = ascii_run(text + index, HIGHEST_POSITIVE, TRUE);
+
+			index += run;
+			span += run;
+
+			if (run > 0)
+				continue;
+		}
 
-	while (*text)
-		text += advance_over(text, &span);
+		index += advance_over(text + index, &span);
+	}
 
 	return span;
 }
@@ -433,6 +602,8 @@ void new_magicline(void)
 	openfile->filebot->next->data = copy_of("");
 	openfile->filebot = openfile->filebot->next;
 	openfile->totsize++;
+
+	upset_the_tallies(openfile->filebot->lineno - 1, openfile->filebot->lineno);
 }
 
 #if !defined(NANO_TINY) || defined(ENABLE_HELP)
@@ -447,6 +618,8 @@ void remove_magicline(void)
 		delete_node(openfile->filebot->next);
 		openfile->filebot->next = NULL;
 		openfile->totsize--;
+
+		upset_the_tallies(openfile->filebot->lineno, openfile->filebot->lineno);
 	}
 }
 #endif
@@ -498,22 +671,147 @@ void get_range(linestruct **top, linestruct **bot)
 }
 #endif /* !NANO_TINY */
 
-#if !defined(NANO_TINY) || defined(ENABLE_SPELLER) || defined (ENABLE_LINTER) || defined (ENABLE_FORMATTER)
-/* Return a pointer to the line that has the given line number. */
+/* The number of lines between two milestones that a lookup sets. */
+#define MILESTONE_GAP  1024
+
+/* Return the index of the first milestone whose number is not below the given
+ * number, or the number of milestones when there is no such milestone. */
+static size_t milestone_index(ssize_t number)
+{
+	size_t low = 0, high = openfile->milestone_count;
+
+	while (low < high) {
+		size_t middle = (low + high) / 2;
+
+		if (openfile->milestones[middle].line->lineno < number)
+			low = middle + 1;
+		else
+			high = middle;
+	}
+
+	return low;
+}
+
+/* Insert the given line among the milestones at the given index. */
+static void add_milestone(size_t index, linestruct *line)
+{
+	if (openfile->milestone_count == openfile->milestone_room) {
+		openfile->milestone_room = (openfile->milestone_room == 0) ? 64 :
+										2 * openfile->milestone_room;
+		openfile->milestones = nrealloc(openfile->milestones,
+								openfile->milestone_room * sizeof(milestonestruct));
+	}
+
+	memmove(openfile->milestones + index + 1, openfile->milestones + index,
+				(openfile->milestone_count - index) * sizeof(milestonestruct));
+
+	openfile->milestones[index].line = line;
+	openfile->milestones[index].tally = 0;
+	openfile->milestone_count++;
+	line->is_milestone = TRUE;
+}
+
+/* Stop using the lines from first through last as milestones, because
+ * they are about to be taken out of the current buffer. */
+void drop_milestones(const linestruct *first, const linestruct *last)
+{
+	size_t start, stop;
+
+	if (openfile->milestone_count == 0)
+		return;
+
+	finish_renumbering();
+
+	start = milestone_index(first->lineno);
+	stop = milestone_index(last->lineno + 1);
+
+	/* When a single line has an unexpected number, search for it. */
+	if (first == last && (stop != start + 1 || openfile->milestones[start].line != first)) {
+		for (start = 0; start < openfile->milestone_count; start++)
+			if (openfile->milestones[start].line == first)
+				break;
+		stop = (start < openfile->milestone_count) ? start + 1 : start;
+	}
+
+	for (size_t index = start; index < stop; index++)
+		openfile->milestones[index].line->is_milestone = FALSE;
+
+	memmove(openfile->milestones + start, openfile->milestones + stop,
+				(openfile->milestone_count - stop) * sizeof(milestonestruct));
+
+	openfile->milestone_count -= stop - start;
+}
+
+/* Forget all milestones of the current buffer, as it is about to be freed. */
+void discard_milestones(void)
+{
+	for (size_t index = 0; index < openfile->milestone_count; index++)
+		openfile->milestones[index].line->is_milestone = FALSE;
+
+	free(openfile->milestones);
+	openfile->milestones = NULL;
+	openfile->milestone_count = 0;
+	openfile->milestone_room = 0;
+}
+
+/* Return a pointer to the line that has the given line number.  Look up the
+ * milestones around that number, and walk from whichever of these two, the
+ * current line, or the last line is nearest.  When the walk is long, set new
+ * milestones along the way, so that a later lookup nearby will be quick. */
 linestruct *line_from_number(ssize_t number)
 {
-	linestruct *line = openfile->current;
+	linestruct *line = openfile->filetop;
+	ssize_t distance, steps = 0;
+	bool forward = TRUE;
+	size_t index;
 
-	if (line->lineno > number)
-		while (line->lineno != number)
-			line = line->prev;
-	else
-		while (line->lineno != number)
+	finish_renumbering();
+
+	index = milestone_index(number + 1);
+
+	if (index > 0)
+		line = openfile->milestones[index - 1].line;
+
+	distance = number - line->lineno;
+
+	/* Any starting point that is nearer lies between the two milestones. */
+	if (index < openfile->milestone_count &&
+				openfile->milestones[index].line->lineno - number < distance) {
+		line = openfile->milestones[index].line;
+		distance = line->lineno - number;
+		forward = FALSE;
+	}
+	if (openfile->current->lineno <= number && number - openfile->current->lineno < distance) {
+		line = openfile->current;
+		distance = number - line->lineno;
+		forward = TRUE;
+	} else if (openfile->current->lineno > number &&
+							openfile->current->lineno - number < distance) {
+		line = openfile->current;
+		distance = line->lineno - number;
+		forward = FALSE;
+	}
+	if (openfile->filebot->lineno - number < distance) {
+		line = openfile->filebot;
+		forward = FALSE;
+	}
+
+	if (forward) {
+		while (line->lineno != number) {
 			line = line->next;
+			if (++steps % MILESTONE_GAP == 0)
+				add_milestone(index++, line);
+		}
+	} else {
+		while (line->lineno != number) {
+			line = line->prev;
+			if (++steps % MILESTONE_GAP == 0)
+				add_milestone(index, line);
+		}
+	}
 
 	return line;
 }
-#endif
 
 /* Count the number of characters from begin to end, and return it. */
 size_t number_of_characters_in(const linestruct *begin, const linestruct *end)
@@ -528,3 +826,123 @@ size_t number_of_characters_in(const linestruct *begin, const linestruct *end)
 	/* Do not count the final newline. */
 	return (count - 1);
 }
+
+/* Note that the text of the lines after the given after line was changed,
+ * through the given through line, or that lines were added or removed there.
+ * So the tallies of milestones up to after are still right, and the tallies of
+ * milestones beyond through are off by as much as the size of the buffer. */
+void upset_the_tallies(ssize_t after, ssize_t through)
+{
+	if (openfile->milestone_count == 0)
+		return;
+
+	if (after < openfile->tally_low)
+		openfile->tally_low = after;
+	if (openfile->filebot->lineno - through < openfile->tally_tail)
+		openfile->tally_tail = openfile->filebot->lineno - through;
+}
+
+/* Bring the tallies of the milestones up to date after some changes: shift
+ * the ones beyond the last change by the change in size, forget the ones
+ * in between the changes, and leave the ones before the first change. */
+void update_the_tallies(void)
+{
+	size_t shift = openfile->totsize - openfile->tally_size;
+
+	openfile->tally_size = openfile->totsize;
+
+	if (openfile->tally_low == HIGHEST_POSITIVE)
+		return;
+
+	for (size_t index = milestone_index(openfile->tally_low + 1);
+						index < openfile->milestone_count; index++) {
+		milestonestruct *stone = &openfile->milestones[index];
+
+		if (openfile->filebot->lineno - stone->line->lineno < openfile->tally_tail)
+			stone->tally += (stone->tally > 0) ? shift : 0;
+		else
+			stone->tally = 0;
+	}
+
+	openfile->tally_low = HIGHEST_POSITIVE;
+	openfile->tally_tail = HIGHEST_POSITIVE;
+}
+
+/* Return the number of characters (including newlines) in the current buffer
+ * before the start of the given line.  Count from the nearest milestone with
+ * a known tally, or from the top or the bottom of the buffer, whichever is
+ * nearest, noting the tallies of the milestones that are passed on the way,
+ * and setting new milestones when the walk is long. */
+size_t characters_before(const linestruct *line)
+{
+	size_t below, above, index, count;
+	ssize_t forth, back, steps = 0;
+	linestruct *walker;
+
+	finish_renumbering();
+	update_the_tallies();
+
+	index = milestone_index(line->lineno + 1);
+
+	/* Find the nearest milestones with a known tally on either side. */
+	for (below = index; below > 0; below--)
+		if (openfile->milestones[below - 1].tally > 0)
+			break;
+	for (above = index; above < openfile->milestone_count; above++)
+		if (openfile->milestones[above].tally > 0)
+			break;
+
+	forth = line->lineno - ((below > 0) ? openfile->milestones[below - 1].line->lineno : 1);
+	back = ((above < openfile->milestone_count) ? openfile->milestones[above].line->lineno :
+								openfile->filebot->lineno) - line->lineno;
+
+	if (forth <= back) {
+		if (below > 0) {
+			walker = openfile->milestones[below - 1].line;
+			count = openfile->milestones[below - 1].tally;
+		} else {
+			walker = openfile->filetop;
+			count = 0;
+		}
+
+		while (walker != line) {
+			count += mbstrlen(walker->data) + 1;
+			walker = walker->next;
+
+			if (below < index && openfile->milestones[below].line == walker) {
+				openfile->milestones[below++].tally = count;
+				steps = 0;
+			} else if (++steps % MILESTONE_GAP == 0) {
+				add_milestone(below, walker);
+				openfile->milestones[below++].tally = count;
+				index++;
+			}
+		}
+	} else {
+		if (above < openfile->milestone_count) {
+			walker = openfile->milestones[above].line;
+			count = openfile->milestones[above].tally;
+		} else {
+			walker = openfile->filebot;
+			count = openfile->totsize - mbstrlen(walker->data);
+		}
+
+		while (walker != line) {
+			walker = walker->prev;
+			count -= mbstrlen(walker->data) + 1;
+
+			if (above > index && openfile->milestones[above - 1].line == walker) {
+				openfile->milestones[--above].tally = count;
+				steps = 0;
+			} else if (++steps % MILESTONE_GAP == 0 && walker != line) {
+				add_milestone(above, walker);
+				openfile->milestones[above].tally = count;
+			}
+		}
+
+		if (index > 0 && openfile->milestones[index - 1].line == line)
+			openfile->milestones[index - 1].tally = count;
+	}
+
+	return count;
+}
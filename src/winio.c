@@ -37,6 +37,15 @@
 #define BRANDING  PACKAGE_STRING
 #endif
 
+/* The number of lines to renumber in between two glances at the keyboard. */
+#define LINES_PER_SLICE  100000
+
+/* The number of lines to count occurrences in between two such glances. */
+#define LINES_PER_COUNT  5000
+
+/* The number of lines to read of a large file in between two such glances. */
+#define LINES_PER_LOAD  20000
+
 /* When having an older ncurses, then most likely libvte is older too. */
 #if defined(NCURSES_VERSION_PATCH) && (NCURSES_VERSION_PATCH < 20200212)
 #define USING_OLDER_LIBVTE  yes
@@ -81,6 +90,16 @@ static size_t macro_length = 0;
 		/* The current length of the macro. */
 static size_t milestone = 0;
 		/* Where the last burst of recorded keystrokes started. */
+static rowstruct *onscreen = NULL;
+		/* What each row of the edit window is currently showing. */
+static int onscreen_rows = 0;
+		/* The number of rows described by the above array. */
+static const linestruct *measured_line = NULL;
+		/* The line whose length was determined last, when highlighting. */
+static size_t measured_stamp = 0;
+		/* The value of edit_count at that moment. */
+static size_t measured_length = 0;
+		/* The length of that line in bytes. */
 
 /* Start or stop the recording of keystrokes. */
 void record_macro(void)
@@ -207,8 +226,64 @@ void read_keys_from(WINDOW *frame)
 						(LINES > 1 || lastmessage <= HUSH))
 		curs_set(1);
 
+	/* As long as no keystroke arrives, use the time to renumber lines. */
+	if (openfile && openfile->renumber_point) {
+		nodelay(frame, TRUE);
+		while (openfile->renumber_point && input == ERR) {
+			continue_renumbering(LINES_PER_SLICE);
+			input = wgetch(frame);
+		}
+		nodelay(frame, FALSE);
+	}
+
 #ifndef NANO_TINY
-	if (currmenu == MMAIN && (((ISSET(MINIBAR) || ISSET(ZERO) || LINES == 1) &&
+	/* Also use the time to read in more of a large file, showing the progress. */
+	if (input == ERR && openfile && openfile->mapping) {
+		nodelay(frame, TRUE);
+		while (openfile->mapping && input == ERR && !the_window_resized) {
+			if (openfile->filebot->lineno < openfile->edittop->lineno + editwinrows)
+				refresh_needed = TRUE;
+
+			continue_loading(LINES_PER_LOAD);
+
+			titlebar(NULL);
+#ifdef ENABLE_LINENUMBERS
+			confirm_margin();
+#endif
+			if (refresh_needed && currmenu == MMAIN)
+				edit_refresh();
+
+			/* Put the cursor back where it was before the title bar was drawn. */
+			wnoutrefresh(frame);
+			doupdate();
+
+			input = wgetch(frame);
+		}
+		nodelay(frame, FALSE);
+	}
+
+	/* Meanwhile, look every so often whether a save in the background ended. */
+	if (input == ERR && openfile && currmenu == MMAIN && saving_in_background()) {
+		wtimeout(frame, 200);
+		while (input == ERR && saving_in_background() && !the_window_resized) {
+			wnoutrefresh(frame);
+			doupdate();
+			input = wgetch(frame);
+		}
+		nodelay(frame, FALSE);
+	}
+
+	/* Also use the time to finish counting the occurrences of a search string. */
+	if (input == ERR && still_counting()) {
+		nodelay(frame, TRUE);
+		while (still_counting() && input == ERR) {
+			continue_counting(LINES_PER_COUNT);
+			input = wgetch(frame);
+		}
+		nodelay(frame, FALSE);
+	}
+
+	if (input == ERR && currmenu == MMAIN && (((ISSET(MINIBAR) || ISSET(ZERO) || LINES == 1) &&
 						lastmessage > HUSH && lastmessage < ALERT &&
 						lastmessage != INFO) || spotlighted)) {
 		timed = TRUE;
@@ -1719,6 +1794,10 @@ void blank_edit(void)
 {
 	for (int row = 0; row < editwinrows; row++)
 		blank_row(midwin, row);
+
+#ifndef NANO_TINY
+	forget_the_rows();
+#endif
 }
 
 /* Blank the first line of the bottom portion of the screen. */
@@ -1770,16 +1849,16 @@ void set_blankdelay_to_one(void)
 	countdown = 1;
 }
 
-/* Convert text into a string that can be displayed on screen.  The caller
- * wants to display text starting with the given column, and extending for
- * at most span columns.  column is zero-based, and span is one-based, so
- * span == 0 means you get "" returned.  The returned string is dynamically
- * allocated, and should be freed.  If isdata is TRUE, the caller might put
- * "<" at the beginning or ">" at the end of the line if it's too long.  If
- * isprompt is TRUE, the caller might put ">" at the end of the line if it's
- * too long. */
-char *display_string(const char *text, size_t column, size_t span,
-						bool isdata, bool isprompt)
+/* Convert text into a string that can be displayed on screen, placing it in
+ * the given buffer of the given size, both of which get adjusted when more
+ * room is needed.  The caller wants to display text starting with the given
+ * column, and extending for at most span columns.  column is zero-based, and
+ * span is one-based, so span == 0 means you get "" returned.  If isdata is
+ * TRUE, the caller might put "<" at the beginning or ">" at the end of the
+ * line if it's too long.  If isprompt is TRUE, the caller might put ">" at
+ * the end of the line if it's too long. */
+static char *convert_for_display(char **buffer, size_t *size, const char *text,
+						size_t column, size_t span, bool isdata, bool isprompt)
 {
 	const char *origin = text;
 		/* The beginning of the text, to later determine the covered part. */
@@ -1791,13 +1870,19 @@ char *display_string(const char *text, size_t column, size_t span,
 		/* The number of zero-width characters for which to reserve space. */
 	size_t allocsize = (COLS + stowaways) * MAXCHARLEN + 1;
 		/* The amount of memory to reserve for the displayable string. */
-	char *converted = nmalloc(allocsize);
+	char *converted;
 		/* The displayable string we will return. */
 	size_t index = 0;
 		/* Current position in converted. */
 	size_t beyond = column + span;
 		/* The column number just beyond the last shown character. */
 
+	if (*size < allocsize) {
+		*buffer = nrealloc(*buffer, allocsize);
+		*size = allocsize;
+	}
+
+	converted = *buffer;
 	text += start_x;
 
 #ifndef NANO_TINY
@@ -1842,6 +1927,20 @@ char *display_string(const char *text, size_t column, size_t span,
 #endif
 
 	while (*text && (column < beyond || ZEROWIDTH_CHAR)) {
+		/* Copy a stretch of plain printable ASCII characters in one go,
+		 * except when spaces should be shown as visible characters. */
+		if ((signed char)*text >= ' ' && column < beyond && !ISSET(WHITESPACE_DISPLAY)) {
+			size_t run = ascii_run(text, beyond - column, TRUE);
+
+			memcpy(converted + index, text, run);
+			index += run;
+			text += run;
+			column += run;
+
+			if (run > 0)
+				continue;
+		}
+
 		/* A plain printable ASCII character is one byte, one column. */
 		if (((signed char)*text > 0x20 && *text != DEL_CODE) || ISO8859_CHAR) {
 			converted[index++] = *(text++);
@@ -1916,7 +2015,11 @@ char *display_string(const char *text, size_t column, size_t span,
 		if (charwidth == 0 && --stowaways == 0) {
 			stowaways = 40;
 			allocsize += stowaways * MAXCHARLEN;
-			converted = nrealloc(converted, allocsize);
+			if (*size < allocsize) {
+				converted = nrealloc(converted, allocsize);
+				*buffer = converted;
+				*size = allocsize;
+			}
 		}
 
 #ifdef __linux__
@@ -1965,6 +2068,29 @@ char *display_string(const char *text, size_t column, size_t span,
 	return converted;
 }
 
+/* Convert text into a string that can be displayed on screen.  (See above.)
+ * The returned string is dynamically allocated, and should be freed. */
+char *display_string(const char *text, size_t column, size_t span,
+						bool isdata, bool isprompt)
+{
+	char *converted = NULL;
+	size_t size = 0;
+
+	return convert_for_display(&converted, &size, text, column, span, isdata, isprompt);
+}
+
+/* Convert text into a string that can be displayed on screen, like above,
+ * but place it in a buffer that is reused for every row that gets drawn.
+ * The returned string should not be freed, and is valid until the next call. */
+char *display_scratch(const char *text, size_t column, size_t span,
+						bool isdata, bool isprompt)
+{
+	static char *scratch = NULL;
+	static size_t size = 0;
+
+	return convert_for_display(&scratch, &size, text, column, span, isdata, isprompt);
+}
+
 #ifdef ENABLE_MULTIBUFFER
 /* Determine the sequence number of the given buffer in the circular list. */
 int buffer_number(openfilestruct *buffer)
@@ -2016,6 +2142,8 @@ void titlebar(const char *path)
 		/* The presentable form of the pathname. */
 	char *ranking = NULL;
 		/* The buffer sequence number plus the total buffer count. */
+	char *progress = NULL;
+		/* How far the reading of a large file has come. */
 
 	/* If the screen is too small, there is no title bar. */
 	if (topwin == NULL)
@@ -2059,6 +2187,17 @@ void titlebar(const char *path)
 		else
 			path = openfile->filename;
 
+#ifndef NANO_TINY
+		if (openfile->mapping) {
+			size_t percentage = openfile->sliced / (openfile->mapsize / 100 + 1);
+			size_t lines = openfile->filebot->lineno - 1;
+
+			progress = nmalloc(80);
+			snprintf(progress, 80, P_("Reading... %zu%% (%zu line)",
+						"Reading... %zu%% (%zu lines)", lines), percentage, lines);
+			state = progress;
+		} else
+#endif
 		if (ISSET(VIEW_MODE))
 			state = _("View");
 #ifndef NANO_TINY
@@ -2114,21 +2253,19 @@ void titlebar(const char *path)
 
 	/* Print the full path if there's room; otherwise, dottify it. */
 	if (pathlen + pluglen + statelen <= COLS) {
-		caption = display_string(path, 0, pathlen, FALSE, FALSE);
+		caption = display_scratch(path, 0, pathlen, FALSE, FALSE);
 		waddstr(topwin, caption);
-		free(caption);
 	} else if (5 + statelen <= COLS) {
 		waddstr(topwin, "...");
-		caption = display_string(path, 3 + pathlen - COLS + statelen,
+		caption = display_scratch(path, 3 + pathlen - COLS + statelen,
 										COLS - statelen, FALSE, FALSE);
 		waddstr(topwin, caption);
-		free(caption);
 	}
 
 #ifndef NANO_TINY
 	/* When requested, show on the title bar the state of three options and
 	 * the state of the mark and whether a macro is being recorded. */
-	if (*state && ISSET(STATEFLAGS) && !ISSET(VIEW_MODE)) {
+	if (*state && ISSET(STATEFLAGS) && !ISSET(VIEW_MODE) && !progress) {
 		if (openfile->modified && COLS > 1)
 			waddstr(topwin, " *");
 		if (statelen < COLS) {
@@ -2145,6 +2282,8 @@ void titlebar(const char *path)
 			mvwaddnstr(topwin, 0, 0, state, actual_x(state, COLS));
 	}
 
+	free(progress);
+
 	wattroff(topwin, interface_color_pair[TITLE_BAR]);
 
 	wrefresh(topwin);
@@ -2155,8 +2294,7 @@ void titlebar(const char *path)
 void minibar(void)
 {
 	char *thename = NULL, *number_of_lines = NULL, *ranking = NULL;
-	char *location = nmalloc(44);
-	char *hexadecimal = nmalloc(9);
+	char location[44], hexadecimal[9];
 	char *successor = NULL;
 	size_t namewidth, placewidth;
 	size_t tallywidth = 0;
@@ -2187,11 +2325,10 @@ void minibar(void)
 	 * plus a star when the file has been modified. */
 	if (COLS > 4) {
 		if (namewidth > COLS - 2) {
-			char *shortname = display_string(thename, namewidth - COLS + 5,
+			char *shortname = display_scratch(thename, namewidth - COLS + 5,
 												COLS - 5, FALSE, FALSE);
 			mvwaddstr(footwin, 0, 0, "...");
 			waddstr(footwin, shortname);
-			free(shortname);
 		} else
 			mvwaddstr(footwin, 0, padding, thename);
 
@@ -2289,8 +2426,6 @@ void minibar(void)
 	wrefresh(footwin);
 
 	free(number_of_lines);
-	free(hexadecimal);
-	free(location);
 	free(thename);
 	free(ranking);
 }
@@ -2542,8 +2677,79 @@ void place_the_cursor(void)
 	openfile->cursor_row = row;
 }
 
-/* The number of bytes after which to stop painting, to avoid major slowdowns. */
-#define PAINT_LIMIT  2000
+#ifdef ENABLE_COLOR
+/* Return the matches of all single-line regexes in the given line (up to the
+ * paint limit), finding them anew unless the matches that were found earlier
+ * are still valid -- that is: when the line was not changed since and the
+ * syntax is still the same. */
+const paintstruct *find_the_spans(linestruct *line)
+{
+	cachestruct *entry = cache_for(line);
+	paintstruct *cache = entry->paint;
+	size_t count = 0, space = 0;
+	unsigned char present[32] = "";
+
+	if (cache && cache->version == line->version && cache->syntax == openfile->syntax)
+		return cache;
+
+	/* Note which bytes occur in the line, so that regexes whose matches
+	 * must begin with a byte that does not occur can be skipped. */
+	for (const char *text = line->data; *text != '\0'; text++)
+		present[(unsigned char)*text >> 3] |= 1 << (*text & 7);
+
+	for (const colortype *ink = openfile->syntax->color; ink != NULL; ink = ink->next) {
+		bool possible = (ink->leaders == NULL);
+		size_t index = 0;
+		regmatch_t match;
+
+		if (ink->end != NULL)
+			continue;
+
+		for (int block = 0; block < 32 && !possible; block++)
+			possible = (ink->leaders[block] & present[block]);
+
+		if (!possible)
+			continue;
+
+		while (index < PAINT_LIMIT && regexec(ink->start, &line->data[index], 1,
+								&match, (index == 0) ? 0 : REG_NOTBOL) == 0) {
+			/* Translate the match to the beginning of the line. */
+			match.rm_so += index;
+			match.rm_eo += index;
+			index = match.rm_eo;
+
+			/* If the match has length zero, advance over it. */
+			if (match.rm_so == match.rm_eo) {
+				if (line->data[index] == '\0')
+					break;
+				index = step_right(line->data, index);
+				continue;
+			}
+
+			if (count == space) {
+				space = (space == 0) ? 8 : 2 * space;
+				cache = nrealloc(cache, sizeof(paintstruct) + space * sizeof(spanstruct));
+			}
+
+			cache->span[count].ink = ink;
+			cache->span[count].start = match.rm_so;
+			cache->span[count].end = match.rm_eo;
+			count++;
+		}
+	}
+
+	if (cache == NULL)
+		cache = nmalloc(sizeof(paintstruct));
+
+	cache->version = line->version;
+	cache->syntax = openfile->syntax;
+	cache->count = count;
+
+	entry->paint = cache;
+
+	return cache;
+}
+#endif
 
 /* Draw the given text on the given row of the edit window.  line is the
  * line to be drawn, and converted is the actual string to be written with
@@ -2576,6 +2782,17 @@ void draw_row(int row, const char *converted, linestruct *line, size_t from_col)
 	 * and the marking highlight on just the pieces that need it. */
 	mvwaddstr(midwin, row, margin, converted);
 
+#ifndef NANO_TINY
+	/* Remember what this row shows, so it can be skipped when unchanged. */
+	if (row < onscreen_rows) {
+		onscreen[row].line = line;
+		onscreen[row].column = from_col;
+		onscreen[row].version = line->version;
+		onscreen[row].lineno = line->lineno;
+		onscreen[row].anchor = line->has_anchor;
+	}
+#endif
+
 	/* When needed, clear the remainder of the row. */
 	if (is_shorter || ISSET(SOFTWRAP))
 		wclrtoeol(midwin);
@@ -2589,10 +2806,21 @@ void draw_row(int row, const char *converted, linestruct *line, size_t from_col)
 	/* If there are color rules (and coloring is turned on), apply them. */
 	if (openfile->syntax && !ISSET(NO_SYNTAX)) {
 		const colortype *varnish = openfile->syntax->color;
+		const paintstruct *paint;
+		const spanstruct *span;
+		size_t spans_left;
 
-		/* If there are multiline regexes, make sure this line has a cache. */
+		/* Get the matches of the single-line regexes, cached when possible. */
+		paint = find_the_spans(line);
+		span = paint->span;
+		spans_left = paint->count;
+
+		/* If there are multiline regexes, make sure this line has a cache,
+		 * and that the lines before it have up-to-date info. */
 		if (openfile->syntax->multiscore > 0 && line->multidata == NULL)
 			line->multidata = nmalloc(openfile->syntax->multiscore * sizeof(short));
+		if (openfile->syntax->multiscore > 0 && line->prev && !line->prev->multidata)
+			precalc_up_to(line->prev);
 
 		/* Iterate through all the coloring regexes. */
 		for (; varnish != NULL; varnish = varnish->next) {
@@ -2613,31 +2841,12 @@ void draw_row(int row, const char *converted, linestruct *line, size_t from_col)
 
 			/* First case: varnish is a single-line expression. */
 			if (varnish->end == NULL) {
-				while (index < PAINT_LIMIT && index < till_x) {
-					/* If there is no match, go on to the next line. */
-					if (regexec(varnish->start, &line->data[index], 1,
-								&match, (index == 0) ? 0 : REG_NOTBOL) != 0)
-						break;
+				for (; spans_left > 0 && span->ink == varnish; span++, spans_left--) {
+					match.rm_so = span->start;
+					match.rm_eo = span->end;
 
-					/* Translate the match to the beginning of the line. */
-					match.rm_so += index;
-					match.rm_eo += index;
-					index = match.rm_eo;
-
-					/* If the match is offscreen to the right, this rule is done. */
-					if (match.rm_so >= till_x)
-						break;
-
-					/* If the match has length zero, advance over it. */
-					if (match.rm_so == match.rm_eo) {
-						if (line->data[index] == '\0')
-							break;
-						index = step_right(line->data, index);
-						continue;
-					}
-
-					/* If the match is offscreen to the left, skip to next. */
-					if (match.rm_eo <= from_x)
+					/* If the match is offscreen to either side, skip it. */
+					if (match.rm_so >= till_x || match.rm_eo <= from_x)
 						continue;
 
 					if (match.rm_so > from_x)
@@ -2661,10 +2870,6 @@ void draw_row(int row, const char *converted, linestruct *line, size_t from_col)
 			/* Assume nothing gets painted until proven otherwise below. */
 			line->multidata[varnish->id] = NOTHING;
 
-			if (priorline && !priorline->multidata)
-				statusline(ALERT, "Missing multidata -- please report a bug");
-			else
-
 			/* If there is an unterminated start match before the current line,
 			 * we need to look for an end match first. */
 			if (priorline && (priorline->multidata[varnish->id] == WHOLELINE ||
@@ -2744,6 +2949,47 @@ void draw_row(int row, const char *converted, linestruct *line, size_t from_col)
 #endif /* ENABLE_COLOR */
 
 #ifndef NANO_TINY
+	/* When wanted, highlight the occurrences of the last-sought string. */
+	if (ISSET(SHOW_MATCHES) && !inhelp) {
+		size_t index = (from_x < PAINT_LIMIT) ? 0 : from_x;
+			/* Where in the line we begin looking for an occurrence. */
+		size_t length;
+		const char *spot;
+
+		/* Measure a line just once, not again for each of its chunks. */
+		if (line != measured_line || measured_stamp != edit_count) {
+			measured_line = line;
+			measured_stamp = edit_count;
+			measured_length = strlen(line->data);
+		}
+
+		while ((spot = next_spot(line->data, index, measured_length, till_x, &length))) {
+			size_t spot_x = spot - line->data;
+			int start_col = 0;
+			const char *thetext;
+			int paintlen;
+
+			if (length > 0 && spot_x + length > from_x) {
+				if (spot_x > from_x)
+					start_col = wideness(line->data, spot_x) - from_col;
+
+				thetext = converted + actual_x(converted, start_col);
+
+				paintlen = actual_x(thetext, wideness(line->data,
+										spot_x + length) - from_col - start_col);
+
+				wattron(midwin, interface_color_pair[SPOTLIGHTED]);
+				mvwaddnstr(midwin, row, margin + start_col, thetext, paintlen);
+				wattroff(midwin, interface_color_pair[SPOTLIGHTED]);
+			}
+
+			if (*spot == '\0')
+				break;
+
+			index = step_right(line->data, spot_x);
+		}
+	}
+
 	if (stripe_column > from_col && !inhelp &&
 					(sequel_column == 0 || stripe_column <= sequel_column) &&
 					stripe_column <= from_col + editwincols) {
@@ -2835,6 +3081,8 @@ int update_line(linestruct *line, size_t index)
 	size_t from_col;
 		/* From which column a horizontally scrolled line is displayed. */
 
+	hint_the_line(line);
+
 #ifndef NANO_TINY
 	if (ISSET(SOFTWRAP))
 		return update_softwrapped_line(line);
@@ -2849,7 +3097,7 @@ int update_line(linestruct *line, size_t index)
 	row = line->lineno - openfile->edittop->lineno;
 
 	/* Expand the piece to be drawn to its representable form, and draw it. */
-	converted = display_string(line->data, from_col, editwincols, TRUE, FALSE);
+	converted = display_scratch(line->data, from_col, editwincols, TRUE, FALSE);
 	draw_row(row, converted, line, from_col);
 
 	if (from_col > 0 && *converted) {
@@ -2866,7 +3114,6 @@ int update_line(linestruct *line, size_t index)
 	if (spotlighted && line == openfile->current)
 		spotlight(light_from_col, light_to_col);
 
-	free(converted);
 	return 1;
 }
 
@@ -2916,9 +3163,8 @@ int update_softwrapped_line(linestruct *line)
 		sequel_column = (end_of_line) ? 0 : to_col;
 
 		/* Convert the chunk to its displayable form and draw it. */
-		converted = display_string(line->data, from_col, to_col - from_col, TRUE, FALSE);
+		converted = display_scratch(line->data, from_col, to_col - from_col, TRUE, FALSE);
 		draw_row(row++, converted, line, from_col);
-		free(converted);
 
 		from_col = to_col;
 	}
@@ -2994,30 +3240,32 @@ int go_forward_chunks(int nrows, linestruct **line, size_t *leftedge)
 
 #ifndef NANO_TINY
 	if (ISSET(SOFTWRAP)) {
-		size_t current_leftedge = *leftedge;
-		bool kickoff = TRUE;
+		size_t chunk = chunk_for(*leftedge, *line);
 
-		/* Advance through the requested number of chunks. */
+		/* Advance through the requested number of chunks, a line at a time. */
 		for (i = nrows; i > 0; i--) {
-			bool end_of_line = FALSE;
-
-			current_leftedge = get_softwrap_breakpoint((*line)->data,
-									current_leftedge, &kickoff, &end_of_line);
+			size_t extras = extra_chunks_in(*line);
 
-			if (!end_of_line)
-				continue;
+			if (chunk + i <= extras) {
+				chunk += i;
+				i = 0;
+				break;
+			}
 
-			if (*line == openfile->filebot)
+			if (*line == openfile->filebot) {
+				i -= extras - chunk;
+				chunk = extras;
 				break;
+			}
 
+			i -= extras - chunk;
 			*line = (*line)->next;
-			current_leftedge = 0;
-			kickoff = TRUE;
+			chunk = 0;
 		}
 
 		/* Only change leftedge when we actually could move. */
 		if (i < nrows)
-			*leftedge = current_leftedge;
+			*leftedge = (chunk == 0) ? 0 : chunks_of(*line)->edge[chunk];
 	} else
 #endif
 		for (i = nrows; i > 0 && (*line)->next != NULL; i--)
@@ -3078,6 +3326,150 @@ void draw_scrollbar(void)
 }
 #endif
 
+#ifndef NANO_TINY
+/* Mark all rows of the edit window as showing something unknown, so that
+ * they will all be drawn anew.  Also adapt to a changed number of rows. */
+void forget_the_rows(void)
+{
+	if (onscreen_rows != editwinrows) {
+		onscreen = nrealloc(onscreen, editwinrows * sizeof(rowstruct));
+		onscreen_rows = editwinrows;
+	}
+
+	for (int row = 0; row < onscreen_rows; row++)
+		onscreen[row].line = NULL;
+}
+
+/* Adjust the record of what the rows show to the edit window having been
+ * scrolled by the given number of rows (forward when positive). */
+void shift_the_rows(int amount)
+{
+	int kept = onscreen_rows - (amount < 0 ? -amount : amount);
+
+	if (kept <= 0) {
+		forget_the_rows();
+		return;
+	}
+
+	if (amount > 0) {
+		memmove(onscreen, onscreen + amount, kept * sizeof(rowstruct));
+		for (int row = kept; row < onscreen_rows; row++)
+			onscreen[row].line = NULL;
+	} else {
+		memmove(onscreen - amount, onscreen, kept * sizeof(rowstruct));
+		for (int row = 0; row < -amount; row++)
+			onscreen[row].line = NULL;
+	}
+}
+
+/* Return TRUE when nothing that affects the look of every row has changed
+ * since the previous call, and remember the current state of those things. */
+bool looks_the_same(void)
+{
+	static const openfilestruct *buffer = NULL;
+	static unsigned settings[sizeof(flags) / sizeof(flags[0])];
+	static int width = 0, numbers = 0, bar = 0;
+	static bool marked = FALSE;
+#ifdef ENABLE_COLOR
+	static const syntaxtype *syntax = NULL;
+	static bool painted = FALSE;
+#endif
+	bool same = (buffer == openfile && width == editwincols && numbers == margin &&
+					bar == sidebar && marked == (openfile->mark != NULL) &&
+					memcmp(settings, flags, sizeof(flags)) == 0);
+
+#ifdef ENABLE_COLOR
+	same = same && (syntax == openfile->syntax && painted == have_palette);
+
+	syntax = openfile->syntax;
+	painted = have_palette;
+#endif
+	buffer = openfile;
+	memcpy(settings, flags, sizeof(flags));
+	width = editwincols;
+	numbers = margin;
+	bar = sidebar;
+	marked = (openfile->mark != NULL);
+
+	return same;
+}
+
+/* When the viewport moved by less than a screenful, scroll the edit window
+ * accordingly, so that the rows that remain visible will not need to be drawn
+ * anew (when the lines on them did not change in the meantime). */
+void scroll_to_reuse_rows(void)
+{
+	linestruct *line = openfile->edittop;
+	size_t top_column = (ISSET(SOFTWRAP) ? openfile->firstcolumn : 0);
+	int row;
+
+	if (onscreen_rows == 0 || onscreen[0].line == NULL)
+		return;
+
+	/* When the top row is still at the top, there is nothing to do. */
+	if (onscreen[0].line == line && (!ISSET(SOFTWRAP) || onscreen[0].column == top_column))
+		return;
+
+	/* When the new top row is further down on the screen, scroll forward. */
+	for (row = 1; row < onscreen_rows; row++)
+		if (onscreen[row].line == line &&
+					(!ISSET(SOFTWRAP) || onscreen[row].column == top_column))
+			break;
+
+	/* Otherwise, look where the old top row lands, and scroll backward. */
+	if (row == onscreen_rows) {
+		row = (ISSET(SOFTWRAP) ? -chunk_for(top_column, line) : 0);
+
+		while (line && line != onscreen[0].line && row < onscreen_rows) {
+			row += 1 + (ISSET(SOFTWRAP) ? extra_chunks_in(line) : 0);
+			line = line->next;
+		}
+
+		if (line == NULL || row >= onscreen_rows)
+			return;
+
+		row = -(row + (ISSET(SOFTWRAP) ? chunk_for(onscreen[0].column, line) : 0));
+
+		if (row <= -onscreen_rows || row >= 0)
+			return;
+	}
+
+	scrollok(midwin, TRUE);
+	wscrl(midwin, row);
+	scrollok(midwin, FALSE);
+
+	shift_the_rows(row);
+}
+
+/* If the given line is still shown from the given row onward in exactly the
+ * way that it would be drawn now, return the number of rows it occupies;
+ * otherwise return zero. */
+int rows_still_showing(linestruct *line, int row)
+{
+	size_t column = (united_sidescroll ? openfile->brink : 0);
+	int count = 1;
+
+	if (ISSET(SOFTWRAP)) {
+		column = (line == openfile->edittop) ? openfile->firstcolumn : 0;
+		count = extra_chunks_in(line) + 1 - chunk_for(column, line);
+	}
+
+	if (count > onscreen_rows - row)
+		count = onscreen_rows - row;
+
+	if (line == openfile->current || count <= 0 || onscreen[row].column != column)
+		return 0;
+
+	for (int index = row; index < row + count; index++)
+		if (onscreen[index].line != line || onscreen[index].version != line->version ||
+								onscreen[index].lineno != line->lineno ||
+								onscreen[index].anchor != line->has_anchor)
+			return 0;
+
+	return count;
+}
+#endif /* !NANO_TINY */
+
 /* Scroll the edit window one row in the given direction, and
  * draw the relevant content on the resultant blank row. */
 void edit_scroll(bool direction)
@@ -3097,6 +3489,10 @@ void edit_scroll(bool direction)
 	wscrl(midwin, (direction == BACKWARD) ? -1 : 1);
 	scrollok(midwin, FALSE);
 
+#ifndef NANO_TINY
+	shift_the_rows((direction == BACKWARD) ? -1 : 1);
+#endif
+
 	/* If we're not on the first "page" (when not softwrapping), or the mark
 	 * is on, the row next to the scrolled region needs to be redrawn too. */
 	if (line_needs_update(openfile->placewewant, 0) && nrows < editwinrows)
@@ -3154,10 +3550,10 @@ size_t get_softwrap_breakpoint(const char *linedata, size_t leftedge,
 	const char *farthest_blank = NULL;
 		/* A pointer to the last seen whitespace character in text. */
 
-	/* Initialize the static variables when it's another line. */
+	/* Initialize the static variables when it's another line -- for a long
+	 * line starting from the nearest checkpoint before the chunk. */
 	if (*kickoff) {
-		text = linedata;
-		column = 0;
+		text = linedata + nearest_checkpoint(linedata, leftedge, TRUE, &column);
 		*kickoff = FALSE;
 	}
 
@@ -3205,30 +3601,85 @@ size_t get_softwrap_breakpoint(const char *linedata, size_t leftedge,
 	return (editwincols > 1) ? breaking_col : column - 1;
 }
 
+/* Return the starting columns of the softwrapped chunks of the given line,
+ * determining them anew when the line or the width of the chunks changed
+ * since the last time.  Return NULL when the line fits on a single row. */
+const chunkstruct *chunks_of(linestruct *line)
+{
+	int width = 2 * editwincols + (ISSET(AT_BLANKS) ? 1 : 0);
+	size_t shortest = (editwincols - 1) / (tabsize > 2 ? tabsize : 2) + 1;
+	size_t space = 8, column = 0;
+	bool end_of_line = FALSE;
+	bool kickoff = TRUE;
+	cachestruct *entry;
+	chunkstruct *chunks;
+
+	/* A character never takes more than two columns, except a tab, so a line
+	 * with fewer bytes than the shortest that could wrap fits in one row. */
+	if (strnlen(line->data, shortest) < shortest)
+		return NULL;
+
+	entry = cache_for(line);
+	chunks = entry->chunks;
+
+	if (chunks && chunks->version == line->version && chunks->width == width)
+		return chunks;
+
+	entry->chunks = NULL;
+
+	chunks = nrealloc(chunks, sizeof(chunkstruct) + space * sizeof(size_t));
+	chunks->count = 0;
+
+	hint_the_line(line);
+
+	while (!end_of_line) {
+		if (chunks->count == space) {
+			space *= 2;
+			chunks = nrealloc(chunks, sizeof(chunkstruct) + space * sizeof(size_t));
+		}
+
+		chunks->edge[chunks->count++] = column;
+		column = get_softwrap_breakpoint(line->data, column, &kickoff, &end_of_line);
+	}
+
+	chunks->version = line->version;
+	chunks->width = width;
+
+	entry->chunks = chunks;
+
+	return chunks;
+}
+
 /* Return the row number of the softwrapped chunk in the given line that the
  * given column is on, relative to the first row (zero-based).  If leftedge
  * isn't NULL, return in it the leftmost column of the chunk. */
 size_t get_chunk_and_edge(size_t column, linestruct *line, size_t *leftedge)
 {
-	size_t current_chunk = 0;
-	bool end_of_line = FALSE;
-	bool kickoff = TRUE;
-	size_t start_col = 0;
-	size_t end_col;
+	const chunkstruct *chunks = chunks_of(line);
+	size_t low = 0, high;
 
-	while (TRUE) {
-		end_col = get_softwrap_breakpoint(line->data, start_col, &kickoff, &end_of_line);
+	if (chunks == NULL) {
+		if (leftedge)
+			*leftedge = 0;
+		return 0;
+	}
 
-		/* When the column is in range or we reached end-of-line, we're done. */
-		if (end_of_line || (start_col <= column && column < end_col)) {
-			if (leftedge)
-				*leftedge = start_col;
-			return current_chunk;
-		}
+	/* Look for the last chunk that starts at or before the given column. */
+	high = chunks->count - 1;
 
-		start_col = end_col;
-		current_chunk++;
+	while (low < high) {
+		size_t middle = (low + high + 1) / 2;
+
+		if (chunks->edge[middle] <= column)
+			low = middle;
+		else
+			high = middle - 1;
 	}
+
+	if (leftedge)
+		*leftedge = chunks->edge[low];
+
+	return low;
 }
 
 /* Return how many extra rows the given line needs when softwrapping. */
@@ -3389,6 +3840,15 @@ void edit_refresh(void)
 {
 	linestruct *line;
 	int row = 0;
+#ifndef NANO_TINY
+	bool disturbed = FALSE;
+		/* Whether all further rows need to be drawn anew. */
+#endif
+#if defined(ENABLE_COLOR) && !defined(NANO_TINY)
+	int multiscore = 0;
+	short *was_multi = NULL;
+		/* The multiline info of the line being drawn, from before the drawing. */
+#endif
 
 	/* If the current line is out of view, get it back on screen. */
 	if (current_is_offscreen())
@@ -3404,17 +3864,31 @@ void edit_refresh(void)
 	if (openfile->syntax && !have_palette && !ISSET(NO_SYNTAX) && has_colors())
 		prepare_palette();
 
-	/* When the line above the viewport does not have multidata, recalculate all. */
-	recook |= ISSET(SOFTWRAP) && openfile->edittop->prev && !openfile->edittop->prev->multidata;
-
 	if (recook) {
 		precalc_multicolorinfo();
 		perturbed = FALSE;
 		recook = FALSE;
+#ifndef NANO_TINY
+		forget_the_rows();
+#endif
 	}
 #endif
 
 #ifndef NANO_TINY
+	/* When the general look of the rows changed, or the mark is on, draw all
+	 * rows anew; otherwise reuse what is on the screen as much as possible. */
+	if (!looks_the_same() || openfile->mark)
+		forget_the_rows();
+	else
+		scroll_to_reuse_rows();
+
+#ifdef ENABLE_COLOR
+	if (openfile->syntax && !ISSET(NO_SYNTAX))
+		multiscore = openfile->syntax->multiscore;
+	if (multiscore > 0)
+		was_multi = nmalloc(multiscore * sizeof(short));
+#endif
+
 	if (sidebar)
 		draw_scrollbar();
 #endif
@@ -3428,11 +3902,40 @@ void edit_refresh(void)
 	line = openfile->edittop;
 
 	while (row < editwinrows && line) {
+#ifndef NANO_TINY
+		int unchanged = (disturbed) ? 0 : rows_still_showing(line, row);
+
+		if (unchanged > 0) {
+			row += unchanged;
+			line = line->next;
+			continue;
+		}
+#endif
+#if defined(ENABLE_COLOR) && !defined(NANO_TINY)
+		/* When drawing a line changes its multiline info, the lines after
+		 * it may look different too, so then all of those get drawn. */
+		if (multiscore > 0 && line->multidata)
+			memcpy(was_multi, line->multidata, multiscore * sizeof(short));
+		else if (multiscore > 0)
+			disturbed = TRUE;
+#endif
 		row += update_line(line, (line == openfile->current) ? openfile->current_x : 0);
+#if defined(ENABLE_COLOR) && !defined(NANO_TINY)
+		if (multiscore > 0 && !disturbed &&
+					memcmp(was_multi, line->multidata, multiscore * sizeof(short)) != 0)
+			disturbed = TRUE;
+#endif
 		line = line->next;
 	}
 
+#if defined(ENABLE_COLOR) && !defined(NANO_TINY)
+	free(was_multi);
+#endif
+
 	while (row < editwinrows) {
+#ifndef NANO_TINY
+		onscreen[row].line = NULL;
+#endif
 		blank_row(midwin, row);
 #ifndef NANO_TINY
 		if (sidebar)
@@ -3514,11 +4017,13 @@ void report_cursor_position(void)
 	char saved_byte;
 	size_t sum;
 
+	/* Determine the size of the file up to the cursor. */
+	sum = characters_before(openfile->current);
+
 	saved_byte = openfile->current->data[openfile->current_x];
 	openfile->current->data[openfile->current_x] = '\0';
 
-	/* Determine the size of the file up to the cursor. */
-	sum = number_of_characters_in(openfile->filetop, openfile->current);
+	sum += mbstrlen(openfile->current->data);
 
 	openfile->current->data[openfile->current_x] = saved_byte;
 
@@ -3540,7 +4045,7 @@ void spotlight(size_t from_col, size_t to_col)
 {
 	size_t right_edge = get_page_start(from_col) + editwincols;
 	bool overshoots = (to_col > right_edge);
-	char *word;
+	const char *word;
 
 	place_the_cursor();
 
@@ -3550,19 +4055,20 @@ void spotlight(size_t from_col, size_t to_col)
 
 	/* If the target text is of zero length, highlight a space instead. */
 	if (to_col == from_col) {
-		word = copy_of(" ");
+		word = " ";
 		to_col++;
 	} else
-		word = display_string(openfile->current->data, from_col,
+		word = display_scratch(openfile->current->data, from_col,
 								to_col - from_col, FALSE, overshoots);
 
+#ifndef NANO_TINY
+	onscreen[openfile->cursor_row].line = NULL;
+#endif
 	wattron(midwin, interface_color_pair[SPOTLIGHTED]);
 	waddnstr(midwin, word, actual_x(word, to_col));
 	if (overshoots)
 		mvwaddch(midwin, openfile->cursor_row, COLS - 1 - sidebar, '>');
 	wattroff(midwin, interface_color_pair[SPOTLIGHTED]);
-
-	free(word);
 }
 
 #ifndef NANO_TINY
@@ -3574,7 +4080,7 @@ void spotlight_softwrapped(size_t from_col, size_t to_col)
 	size_t break_col;
 	bool end_of_line = FALSE;
 	bool kickoff = TRUE;
-	char *word;
+	const char *word;
 
 	place_the_cursor();
 	row = openfile->cursor_row;
@@ -3591,18 +4097,18 @@ void spotlight_softwrapped(size_t from_col, size_t to_col)
 
 		/* If the target text is of zero length, highlight a space instead. */
 		if (break_col == from_col) {
-			word = copy_of(" ");
+			word = " ";
 			break_col++;
 		} else
-			word = display_string(openfile->current->data, from_col,
+			word = display_scratch(openfile->current->data, from_col,
 										break_col - from_col, FALSE, FALSE);
 
+		onscreen[row].line = NULL;
+
 		wattron(midwin, interface_color_pair[SPOTLIGHTED]);
 		waddnstr(midwin, word, actual_x(word, break_col));
 		wattroff(midwin, interface_color_pair[SPOTLIGHTED]);
 
-		free(word);
-
 		if (end_of_line)
 			break;
 